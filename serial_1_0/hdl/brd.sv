@@ -1,3 +1,8 @@
+// Baud rate generator
+// Emits a one-clock tick on out every ibrd + fbrd/256 clocks on average:
+// the fractional part accumulates once per period and each carry stretches
+// that period by one clock. The serializers take 4, 8 or 16 ticks per bit
+// (control[14:13]), so ibrd.fbrd = CLK_FREQ / (ticks_per_bit * baud)
 module brd (
     input wire clk,
 	input wire reset,
@@ -6,31 +11,28 @@ module brd (
     input wire [7:0] fbrd,
     output reg out
 );
-    
-
-    // Initialize counters
-    reg [31:0] count;
-    reg [31:0] fr_count;
 
+    reg [23:0] count;
+    reg [8:0] fr_acc;           // [8] is the carry from the last period
 
     always_ff @(posedge clk) begin
 		if (reset == 1'b0) begin
 			out <= 0;
 			count <= 0;
-			fr_count <= 0;
+			fr_acc <= 0;
 		end else if (enable) begin
-			fr_count <= fr_count + fbrd;
-			if (fr_count >= 9'd256) begin
-				fr_count <= fr_count - 9'd256; 
-				count <= count + 1;
-			end
-			if (count >= ibrd) begin
+			out <= 0;
+			if (count + 25'd1 >= ibrd + fr_acc[8]) begin
 				count <= 0;
-				out <= ~out;
+				out <= 1;
+				fr_acc <= fr_acc[7:0] + fbrd;
 			end else begin
 				count <= count + 1;
 			end
+		end else begin
+			out <= 0;
+			count <= 0;
 		end
 	end
 
-endmodule
\ No newline at end of file
+endmodule
@@ -0,0 +1,98 @@
+// Parameterized FIFO (first word fall through)
+// 2**ADDR_WIDTH entries of WIDTH bits, 16 (ADDR_WIDTH = 4) to 4096 (ADDR_WIDTH = 12)
+//
+// The memory is read synchronously so large FIFOs infer block RAM; the
+// address of the next head entry is presented one clock early and a
+// write-through bypass covers a write into the slot being read, so rd_data
+// is the head entry whenever empty is low and a pop takes a single clock
+module fifo #(
+    parameter integer ADDR_WIDTH = 4,
+    parameter integer WIDTH = 9
+)(
+    input wire clk,                   
+    input wire reset,                 
+    input wire [WIDTH-1:0] wr_data,       
+    input wire wr_request,            
+    output wire [WIDTH-1:0] rd_data,        
+    input wire rd_request,            
+    output wire empty,              
+    output wire full,                 
+    output reg overflow,       
+    input wire clear_overflow_request,
+    output reg [ADDR_WIDTH:0] wr_index,       
+    output reg [ADDR_WIDTH:0] rd_index,      
+    output wire [ADDR_WIDTH:0] watermark       
+);		
+	
+	localparam integer DEPTH = 1 << ADDR_WIDTH;
+
+    wire do_write = wr_request && !full;
+    wire do_read = rd_request && !empty;
+    wire [ADDR_WIDTH:0] rd_index_next = rd_index + do_read;
+
+    reg [WIDTH-1:0] ram_data;
+    reg [WIDTH-1:0] bypass_data;
+    reg bypass;
+
+    // Storage: block RAM above 64 entries, LUT RAM below
+    generate
+        if (DEPTH > 64) begin : g_bram
+            (* ram_style = "block" *) reg [WIDTH-1:0] mem [0:DEPTH-1];
+            always_ff @(posedge clk) begin
+                if (do_write)
+                    mem[wr_index[ADDR_WIDTH-1:0]] <= wr_data;
+                ram_data <= mem[rd_index_next[ADDR_WIDTH-1:0]];
+            end
+        end else begin : g_lutram
+            (* ram_style = "distributed" *) reg [WIDTH-1:0] mem [0:DEPTH-1];
+            always_ff @(posedge clk) begin
+                if (do_write)
+                    mem[wr_index[ADDR_WIDTH-1:0]] <= wr_data;
+                ram_data <= mem[rd_index_next[ADDR_WIDTH-1:0]];
+            end
+        end
+    endgenerate
+
+    // Write logic
+    always_ff @(posedge clk) begin
+        if (reset == 1'b0) begin
+            wr_index <= 0;
+            overflow <= 0;
+        end else begin
+            if (clear_overflow_request)
+                overflow <= 0;
+            if (do_write) begin
+                wr_index <= wr_index + 1;       // Increment write index
+            end else if (wr_request && full) begin
+                overflow <= 1;                  // Set overflow flag if FIFO is full
+            end
+        end
+    end
+
+    // Write-through when the entry being written is the next head entry
+    always_ff @(posedge clk) begin
+        bypass <= do_write && (wr_index[ADDR_WIDTH-1:0] == rd_index_next[ADDR_WIDTH-1:0]);
+        bypass_data <= wr_data;
+    end
+
+    // Read logic
+    assign rd_data = empty ? {WIDTH{1'b0}} : (bypass ? bypass_data : ram_data);
+	
+	// Read request handling
+    always_ff @(posedge clk) 
+    begin
+        if (reset == 1'b0) 
+        begin
+            rd_index <= 0;
+        end else if (do_read) 
+		begin
+            rd_index <= rd_index + 1;           
+        end
+    end
+
+    // Status signals
+    assign empty = (wr_index == rd_index);           // FIFO is empty
+    assign full = (wr_index[ADDR_WIDTH-1:0] == rd_index[ADDR_WIDTH-1:0]) && (wr_index[ADDR_WIDTH] != rd_index[ADDR_WIDTH]);   // FIFO is full 
+    assign watermark = wr_index - rd_index;          // Entries in use (0 to DEPTH)
+
+endmodule
@@ -1,16 +1,19 @@
 module receiver (
     input wire clk,
     input wire reset,
-	input wire brgen,
+	input wire brgen,               // Baud rate tick (one clock wide)
+	input wire [1:0] osr,           // Ticks per bit: 00 - 16, 01 - 8, 10 - 4
     input wire enable,
     input wire [1:0] size,
     input wire stop2,               // Stop bit setting (1 or 2 stop bits)
     input wire [1:0] parity,        // Parity settings (0=None, 1=Even, 2=Odd)
     output reg fe,                   // Framing error flag
 	output reg pe,
+	output reg ne,                   // Noise flag: the samples of a bit disagreed
 	input wire clear_fe,
 	input wire clear_pe,
-    output reg [8:0] data,           // Received data
+	input wire clear_ne,
+    output reg [12:0] data,          // Received data: [7:0] byte, [9] fe, [10] pe, [11] break, [12] noise
     output reg data_request,         // Indicates data is ready
     input wire in                   // UART input signal
 );
@@ -26,95 +29,132 @@ module receiver (
     reg [7:0] shift_reg;           // Shift register for received data
     reg parity_bit, received_parity;
 
-    reg [2:0] start_samples;       // Holds sampled bits for majority voting
+	// Every bit is sampled three times around its middle and decided by
+	// majority; the counter restarts on the tick that sees the start bit's
+	// falling edge, so the samples stay centred on the sender's bits rather
+	// than on the free-running tick phase
+    reg [1:0] samples;             // First two samples of the current bit
+	wire [1:0] ones = samples[0] + samples[1] + in;
+	wire vote = ones[1];           // Two or three of the samples were 1
+	wire noisy = samples[0] != samples[1] || samples[1] != in;
+
+	// Per-frame error flags, stored in the FIFO with the byte
+	reg frame_pe;                  // Parity mismatch in this frame
+	reg frame_ne;                  // Noise on at least one bit of this frame
+	reg line_low;                  // Every bit of this frame so far was 0
+	reg wait_idle;                 // After a framing error, wait for the line to go high
 	
 	logic [1:0] stop_bit_count;       // Counter for stop bits
 	
 	logic [2:0] data_length; // 58 bits
 	assign data_length = size + 3'd4;
 	
-	reg [3:0] counter;              // Counter for baud rate ticks (1/16)
-    reg brgen_old;                 // Previous value of brgen
+	reg [3:0] counter;              // Counter for baud rate ticks within a bit
+    wire [3:0] last = 4'd15 >> osr; // Last tick of a bit
+    wire [3:0] mid = last >> 1;     // Tick before the middle of a bit
+    wire decide = (counter == mid + 4'd1); // Third sample: the bit is decided
     
 	
 	always_ff @(posedge clk) begin
     if (reset == 1'b0) begin
-        brgen_old <= 0;
         counter <= 0;
 		state <= IDLE;
         bit_count <= 0;
         data_request <= 0;
-        start_samples <= 3'b000;
+        samples <= 2'b00;
+        fe <= 0;
+        pe <= 0;
+        ne <= 0;
+        wait_idle <= 0;
     end else begin 
+	// Sticky status flags; a new error in this clock takes precedence
+	if (clear_fe)
+		fe <= 0;
+	if (clear_pe)
+		pe <= 0;
+	if (clear_ne)
+		ne <= 0;
 	if(enable) begin
-        brgen_old <= brgen;
-        if (brgen && !brgen_old) begin
+        if (brgen) begin
             counter <= counter + 1;
+			if (counter == mid - 4'd1) samples[0] <= in; // 7th of 16 samples
+			if (counter == mid) samples[1] <= in;        // 8th of 16 samples
+			if (decide && noisy && state != IDLE) begin  // 9th of 16 samples
+				ne <= 1;
+				frame_ne <= 1;
+			end
 			
 			case (state)
 				IDLE: begin
-					if (counter == 4'd15) 
-					begin 
-						counter <= 0;
-					end
+					counter <= 0;
 					data_request <= 0;
-					fe <= 0;
-					start_samples <= 3'b000;
-					if (!in && enable) state <= START; // Detect possible start bit
+					frame_pe <= 0;
+					frame_ne <= 0;
+					line_low <= 1;
+					if (in) wait_idle <= 0;
+					if (!in && !wait_idle) state <= START; // Falling edge: re-centre on it
 				end
 				START: begin
-					if (counter == 3'd6) start_samples[0] <= in; // 7th sample
-					if (counter == 3'd7) start_samples[1] <= in; // 8th sample
-					if (counter == 4'd8) start_samples[2] <= in; // 9th sample
-					if (counter == 4'd15) begin
-					counter <= 0;
-					// Majority voting
-					if ((start_samples[0] + start_samples[1] + start_samples[2]) <= 1) begin
+					// A start bit that does not vote low was a glitch
+					if (decide && vote)
+						state <= IDLE;
+					if (counter == last) begin
+						counter <= 0;
 						state <= DATA;
 						stop_bit_count <= stop2;
 						bit_count <= 0;
-					end else
-						state <= IDLE;
 					end
 				end
-				DATA: 
-					if (counter == 4'd15) begin
-					counter <= 0;
-					shift_reg[bit_count] <= in;
-                    bit_count <= bit_count + 1;
-                    if (bit_count == (data_length)) begin 
-						state <= (parity != 2'b00) ? PARITY : STOP;
-					end else begin
-						state <= DATA;
+				DATA: begin
+					if (decide) begin
+						shift_reg[bit_count] <= vote;
+						if (vote) line_low <= 0;
+					end
+					if (counter == last) begin
+						counter <= 0;
+						bit_count <= bit_count + 1;
+						if (bit_count == (data_length)) begin 
+							state <= (parity != 2'b00) ? PARITY : STOP;
+						end else begin
+							state <= DATA;
+						end
 					end
 				end
-				PARITY: 
-					if (counter == 4'd15) begin
-					counter <= 0;
-					received_parity <= in;
-                    if ((parity == 2'b01 && received_parity != parity_bit) || // Odd parity error
-                        (parity == 2'b10 && received_parity != parity_bit))   // Even parity error
-                        begin 
+				PARITY: begin
+					if (decide) begin
+						received_parity <= vote;
+						if (vote) line_low <= 0;
+						if ((parity == 2'b01 && vote != parity_bit) ||  // Even parity error
+							(parity == 2'b10 && vote != ~parity_bit))   // Odd parity error
+						begin 
 							pe <= 1;
+							frame_pe <= 1;
 						end
-                    state <= STOP;
-                    end
-				STOP: 
-					if (counter == 4'd15) begin
-					counter <= 0;
-					if (stop_bit_count >= 1) begin
-						if(in != 1'b1) fe <= 1; 
-						else begin
+					end
+					if (counter == last) begin
+						counter <= 0;
 						state <= STOP;
+					end
+				end
+				STOP: begin
+					// The frame ends at the middle of its last stop bit, so a
+					// sender running slightly fast can start the next frame
+					// without its start bit being missed
+					if (decide) begin
+						if(!vote) fe <= 1;
+						if (stop_bit_count >= 1 && vote) begin
+							stop_bit_count <= stop_bit_count - 1;
+						end else begin
+							// Deliver the byte with its flags; a low stop bit is a
+							// framing error, or a break if the whole frame was low
+							state <= IDLE;
+							data_request <= 1;
+							data <= {frame_ne || noisy, line_low && !vote, frame_pe, !vote, 1'b0, shift_reg};
+							wait_idle <= !vote;
 						end
-					end else begin
-						if(in != 1'b1) fe <= 1; 
-						else begin
-						state <= IDLE;
-						data_request <= 1;
-						data <= shift_reg;
-						end
-						end
+					end
+					if (counter == last)
+						counter <= 0;
 				end
 				default: state <= IDLE; // Reset to IDLE for safety
 
@@ -125,18 +165,6 @@ module receiver (
     end
 	end
 	
-	always_ff @ (posedge clk) begin
-		if (reset == 1'b0) begin
-			fe <= 0;
-			pe <= 0;
-		end else begin
-			if(clear_fe)
-				fe <= 0;
-			if(clear_pe)
-				pe <= 0;
-		end 
-	end
-	
 	always_comb begin
     case (size)
         2'b00: parity_bit = ^shift_reg[4:0];
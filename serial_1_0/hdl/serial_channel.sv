@@ -0,0 +1,645 @@
+// Serial channel
+// (serial_channel.sv)
+// Jason Losh, Olajumoke Aboderin (from serial_v1_0_AXI.v)
+//
+// One UART: register file, RX/TX FIFOs, baud rate generator, serializers,
+// packed data register, AXI4-stream data path, RTS/CTS flow control and
+// interrupt moderation.
+// serial_v1_0_AXI decodes the AXI4-lite bus and hands each channel its
+// accepted register accesses (wr/rd, already qualified for this channel),
+// so the channel has no handshake of its own: rdata is the combinational
+// read data for raddr, and a packed read completes with rx_pack_done and
+// rx_pack_data some clocks after rd
+
+`timescale 1 ns / 1 ps
+
+    module serial_channel #
+    (
+        // FIFO depths in entries (power of 2, 16 to 4096)
+        parameter integer C_RX_FIFO_DEPTH = 16,
+        parameter integer C_TX_FIFO_DEPTH = 16,
+        // AXI clock in MHz, for the interrupt moderation timer
+        parameter integer C_CLK_MHZ = 100,
+        // Channel number and channel count, reported in the cap register
+        parameter integer C_CHANNEL = 0,
+        parameter integer C_NUM_CHANNELS = 1,
+        // The AXI4-stream ports are connected (control bits 10 and 11
+        // are implemented)
+        parameter integer C_HAS_STREAM = 1
+    )
+    (
+        input wire clk,
+        input wire resetn,
+
+        // Register accesses accepted for this channel
+        input wire wr,
+        input wire [3:0] waddr,
+        input wire [31:0] wdata,
+        input wire [3:0] wstrb,
+        input wire rd,
+        input wire [3:0] raddr,
+        output reg [31:0] rdata,
+
+        // Packed accesses in progress, and packed read completion
+        output wire tx_pack_busy,
+        output wire rx_unpack_busy,
+        output reg rx_pack_done,
+        output reg [31:0] rx_pack_data,
+
+        // Moderated interrupt request
+        output wire intr,
+
+        // Line
+        output wire CLK_OUT,
+        output wire tx_out,
+        input wire rx_in,
+        output wire rts_n,
+        input wire cts_n,
+
+        // AXI4-stream TX input (DMA MM2S) and RX output (DMA S2MM)
+        input wire [7:0] S_AXIS_TX_TDATA,
+        input wire S_AXIS_TX_TVALID,
+        output wire S_AXIS_TX_TREADY,
+        output wire [7:0] M_AXIS_RX_TDATA,
+        output wire M_AXIS_RX_TVALID,
+        input wire M_AXIS_RX_TREADY,
+        output wire M_AXIS_RX_TLAST
+    );
+
+    // FIFO index widths
+    localparam integer RX_ADDR_WIDTH = $clog2(C_RX_FIFO_DEPTH);
+    localparam integer TX_ADDR_WIDTH = $clog2(C_TX_FIFO_DEPTH);
+    localparam [3:0] RX_DEPTH_LOG2 = RX_ADDR_WIDTH;
+    localparam [3:0] TX_DEPTH_LOG2 = TX_ADDR_WIDTH;
+    localparam [3:0] CHANNEL = C_CHANNEL;
+    localparam [3:0] LAST_CHANNEL = C_NUM_CHANNELS - 1;
+
+    // Internals
+    wire [31:0] status;
+    reg [31:0] control;
+    reg [31:0] brd;
+    reg [31:0] rxcfg;
+    reg [31:0] txcfg;
+    reg [31:0] imod;
+    reg [31:0] flow;
+
+    // AXI4-stream data path enables
+    wire tx_dma_enable = control[10];
+    wire rx_dma_enable = control[11];
+
+    // Internal loopback: control[12] feeds the transmitter straight into the
+    // receiver and holds the tx_out pin idle (high)
+    wire loopback = control[12];
+    wire tx_line;
+    wire rx_line = loopback ? tx_line : rx_in;
+    assign tx_out = loopback ? 1'b1 : tx_line;
+
+    // Hardware flow control (active low pins)
+    // control[16] asserts RTS; with control[17] (auto flow) RTS also drops
+    // while the RX FIFO holds at least flow[15:0] entries (0 = full), and
+    // the transmitter waits between frames while CTS is deasserted. In
+    // loopback CTS follows this channel's own RTS and rts_n is held high
+    wire auto_flow = control[17];
+    wire [15:0] rts_level = (flow[15:0] == 16'b0) ? C_RX_FIFO_DEPTH : flow[15:0];
+    wire rx_fifo_high;
+    wire rts = control[16] && !(auto_flow && rx_fifo_high);
+    reg [1:0] cts_sync;
+    wire cts = loopback ? rts : cts_sync[1];
+    wire tx_hold = auto_flow && !cts;
+    assign rts_n = loopback ? 1'b1 : ~rts;
+
+    // Oversampling: control[14:13] selects 16 (00), 8 (01) or 4 (10) baud
+    // ticks per bit; 11 is treated as 4
+    wire [1:0] osr = (control[14:13] == 2'b11) ? 2'b10 : control[14:13];
+
+	// Transmitter
+	 wire tx_fifo_wr_request, tx_fifo_rd_request;
+	 wire [8:0] tx_fifo_data_in;
+	 wire tx_fifo_empty, tx_fifo_full, tx_fifo_overflow;
+	 wire tx_clear_overflow;
+	 wire [TX_ADDR_WIDTH:0] tx_wr_index, tx_rd_index, tx_watermark;
+
+	// Receiver
+	wire [12:0] rx_latch_data;
+	 wire rx_fifo_wr_request, rx_fifo_rd_request;
+	 wire rx_wr_request;
+	 wire [12:0] rx_data_out;
+	 wire rx_fifo_empty, rx_fifo_full, rx_fifo_overflow;
+	 wire rx_clear_overflow, clear_pe, clear_fe, clear_ne;
+	 wire [RX_ADDR_WIDTH:0] rx_wr_index, rx_rd_index, rx_watermark;
+	 wire rx_fe,rx_pe,rx_ne;
+
+	// RX FIFO entries carry the byte in [7:0] and its framing error, parity
+	// error, break and noise flags in [9], [10], [11] and [12]; rx_err_count
+	// tracks how many entries with an error flag are queued so status[15] can
+	// tell software when it needs the per-byte RXD register rather than bulk
+	// reads (noise alone does not count: the byte itself was voted correctly)
+	wire [3:0] rx_head_flags = rx_latch_data[12:9];
+	reg [RX_ADDR_WIDTH:0] rx_err_count;
+	wire rx_err_pending = (rx_err_count != 0);
+
+	// RXD register: head byte, valid, its flags and the entries left behind it
+	wire [15:0] rx_remaining = rx_fifo_empty ? 16'b0 : rx_watermark - 1;
+	wire [31:0] rxd = {rx_remaining, 3'b0, rx_head_flags, ~rx_fifo_empty, rx_latch_data[7:0]};
+
+	// Status register watermark fields are 5 bits and saturate at 31;
+	// the level register holds the full counts for deeper FIFOs
+	wire [4:0] rx_watermark_field, tx_watermark_field;
+	assign rx_watermark_field = (rx_watermark > 31) ? 5'd31 : rx_watermark[4:0];
+	assign tx_watermark_field = (tx_watermark > 31) ? 5'd31 : tx_watermark[4:0];
+
+	assign rx_fifo_high = rx_watermark >= rts_level;
+
+	// Capability register (read-only)
+	wire [31:0] cap;
+	assign cap = {16'b0, CHANNEL, LAST_CHANNEL, TX_DEPTH_LOG2, RX_DEPTH_LOG2};
+
+	// Level register (read-only)
+	wire [31:0] level;
+	assign level = {{(15-TX_ADDR_WIDTH){1'b0}}, tx_watermark, {(15-RX_ADDR_WIDTH){1'b0}}, rx_watermark};
+
+	// RX trigger level and character timeout
+	// rx_trigger is set while the RX FIFO holds at least the trigger level
+	// (0 behaves as 1, i.e. not empty); rx_timeout is set when entries have
+	// been waiting for rx_timeout_chars character times (10 bits of osr ticks)
+	// with no FIFO activity, and clears on the next read or when drained.
+	// With RX DMA enabled the FIFO drains as bytes arrive, so rx_timeout is
+	// instead set once the line has been idle for the same time after a
+	// received byte, and stays set until cleared by writing 1 to status[14]
+	wire [15:0] rx_trigger_level;
+	wire [7:0] rx_timeout_chars;
+	wire rx_trigger;
+	reg rx_timeout;
+
+	// TX low watermark: tx_low is set while the TX FIFO holds no more than
+	// txcfg[15:0] entries, so software can refill before the line idles
+	wire tx_low = tx_watermark <= txcfg[15:0];
+
+	// Interrupt request before moderation, and the microsecond timebase
+	wire intr_request;
+	reg intr_out;
+	reg [7:0] us_div;
+	reg us_tick;
+	reg [15:0] imod_left;
+	reg [19:0] rx_idle_ticks;
+	wire [7:0] char_ticks = 8'd160 >> osr;
+	wire rx_timeout_clear;
+	reg rx_dma_pending;
+	assign rx_trigger_level = rxcfg[15:0];
+	assign rx_timeout_chars = rxcfg[23:16];
+	assign rx_trigger = ~rx_fifo_empty && (rx_watermark >= rx_trigger_level);
+
+	// Packed data register
+	// A write pushes each byte lane whose strobe is set, lane 0 first, one per
+	// clock; a read pops up to 4 bytes into lanes 0-3 and returns once they
+	// are collected, with the byte count latched in status[23:21]
+	reg [31:0] tx_pack_data;
+	reg [3:0] tx_pack_lanes;
+	reg tx_pack_push;
+	reg [8:0] tx_pack_byte;
+	assign tx_pack_busy = (tx_pack_lanes != 4'b0) || tx_pack_push;
+
+	reg [2:0] rx_pack_count;
+	reg [2:0] rx_unpack_count;
+	reg [1:0] rx_unpack_lane;
+	wire rx_unpack_pop = (rx_unpack_count != 3'b0);
+	assign rx_unpack_busy = rx_unpack_pop || rx_pack_done;
+	wire [2:0] rx_pack_avail = rx_dma_enable ? 3'd0 :
+	                           (rx_watermark > 4) ? 3'd4 : rx_watermark[2:0];
+
+	// AXI4-stream data path
+	// With control[10] set the TX FIFO also accepts bytes from S_AXIS_TX, in
+	// clocks where no register write is pushing; with control[11] set the RX
+	// FIFO head is presented on M_AXIS_RX and register reads of the data and
+	// packed registers no longer pop the FIFO
+	// TLAST stays low: the driver runs S2MM as one cyclic transfer and finds
+	// the write position from the residue, so a packet end on an idle line
+	// would close a descriptor early and leave a gap in the ring; partial
+	// periods are flushed by the RX timeout interrupt instead
+	wire tx_axis_push = S_AXIS_TX_TVALID && S_AXIS_TX_TREADY;
+	wire rx_axis_pop = M_AXIS_RX_TVALID && M_AXIS_RX_TREADY;
+	assign S_AXIS_TX_TREADY = tx_dma_enable && ~tx_fifo_full && ~tx_fifo_wr_request && ~tx_pack_push;
+	assign M_AXIS_RX_TVALID = rx_dma_enable && ~rx_fifo_empty;
+	assign M_AXIS_RX_TDATA = rx_latch_data[7:0];
+	assign M_AXIS_RX_TLAST = 1'b0;
+
+	// TX FIFO write port: data register writes, packed lanes and the stream
+	wire tx_fifo_push = tx_fifo_wr_request || tx_pack_push || tx_axis_push;
+	wire [8:0] tx_fifo_push_data = tx_pack_push ? tx_pack_byte :
+	                               tx_fifo_wr_request ? wdata[8:0] : {1'b0, S_AXIS_TX_TDATA};
+
+	// RX FIFO read port: data register reads, packed lanes and the stream
+	wire rx_fifo_pop = rx_fifo_rd_request || rx_unpack_pop || rx_axis_pop;
+
+	// Baud Rate Register
+	wire [23:0]ibrd;
+	wire [7:0]fbrd;
+	wire brd_out;
+	assign ibrd = brd[31:8];
+	assign fbrd = brd[7:0];
+
+    // Register map
+    // ofs  fn
+    //   0  data (r/w)
+    //   4  status (r/w1c)
+    //   8  control (r/w)
+    //  12  brd (r/w)
+    //  16  cap (r)      [3:0] log2 RX FIFO depth, [7:4] log2 TX FIFO depth,
+    //                   [11:8] channel count - 1, [15:12] this channel
+    //  20  level (r)    [15:0] RX FIFO entries, [31:16] TX FIFO entries
+    //  24  rxcfg (r/w)  [15:0] RX trigger level, [23:16] RX timeout in characters (0 = off)
+    //  28  packed (r/w) up to 4 bytes per access, lane 0 first
+    //  32  rxd (r)      [7:0] data, [8] valid, [9] fe, [10] pe, [11] break,
+    //                   [12] noise, [31:16] RX FIFO entries left after this read
+    //  36  txcfg (r/w)  [15:0] TX low watermark in entries
+    //  40  imod (r/w)   [15:0] minimum interrupt spacing in microseconds (0 = off)
+    //  44  flow (r/w)   [15:0] RX FIFO entries at which auto flow drops RTS (0 = full)
+    //  60  ipend (r)    decoded by serial_v1_0_AXI (interrupt pending bitmap)
+    //
+    // Status bit 24 is the sticky noise flag: some bit of a received frame
+    // had samples that disagreed (write 1 to clear); bit 25 is set while the
+    // TX FIFO holds no more than the txcfg low watermark; bits 26 and 27 are
+    // CTS and RTS (1 = asserted)
+    //
+    // Control bits 10 and 11 route TX and RX through the AXI4-stream ports,
+    // bit 12 is internal loopback, bits 14:13 the oversampling ratio,
+    // bit 15 enables the TX low watermark interrupt, bit 16 is RTS and
+    // bit 17 enables automatic RTS/CTS flow control
+    // The baud rate is CLK_FREQ / (brd / 256 * ticks per bit)
+
+    // Register numbers
+    localparam integer DATA_REG		= 4'b0000;
+    localparam integer STATUS_REG	= 4'b0001;
+    localparam integer CONTROL_REG	= 4'b0010;
+    localparam integer BRD_REG		= 4'b0011;
+    localparam integer CAP_REG		= 4'b0100;
+    localparam integer LEVEL_REG	= 4'b0101;
+    localparam integer RXCFG_REG	= 4'b0110;
+    localparam integer PACKED_REG	= 4'b0111;
+    localparam integer RXD_REG		= 4'b1000;
+    localparam integer TXCFG_REG	= 4'b1001;
+    localparam integer IMOD_REG		= 4'b1010;
+    localparam integer FLOW_REG		= 4'b1011;
+
+    // Implemented control register bits (no DMA enables without the
+    // stream ports)
+    localparam [31:0] CONTROL_BITS = C_HAS_STREAM ? 32'h0003FFFF : 32'h0003F3FF;
+
+    // Byte enables as a bit mask
+    wire [31:0] wstrb_mask = {{8{wstrb[3]}}, {8{wstrb[2]}}, {8{wstrb[1]}}, {8{wstrb[0]}}};
+
+    // Data register accesses push or pop the FIFOs in the handshake clock;
+    // the RX FIFO is first word fall through, so the head is already on
+    // rx_latch_data when the read is accepted
+    assign tx_fifo_wr_request = wr && waddr == DATA_REG;
+    assign rx_fifo_rd_request = rd && (raddr == DATA_REG || raddr == RXD_REG) && ~rx_dma_enable;
+
+    // Status register write 1 to clear
+    wire status_wr = wr && waddr == STATUS_REG;
+    assign rx_clear_overflow = status_wr && wstrb[0] && wdata[2];
+    assign tx_clear_overflow = status_wr && wstrb[0] && wdata[5];
+    assign clear_fe          = status_wr && wstrb[0] && wdata[6];
+    assign clear_pe          = status_wr && wstrb[0] && wdata[7];
+    assign clear_ne          = status_wr && wstrb[3] && wdata[24];
+    assign rx_timeout_clear  = status_wr && wstrb[1] && wdata[14];
+
+	// FIFO instantation
+	fifo #(
+		.ADDR_WIDTH(TX_ADDR_WIDTH),
+		.WIDTH(9)
+	) tx_fifo(
+		.clk(clk),
+		.reset(resetn),
+		.wr_data(tx_fifo_push_data),
+		.wr_request(tx_fifo_push),
+		.rd_data(tx_fifo_data_in),
+		.rd_request(tx_fifo_rd_request),
+		.empty(tx_fifo_empty),
+		.full(tx_fifo_full),
+		.overflow(tx_fifo_overflow),
+		.clear_overflow_request(tx_clear_overflow),
+		.wr_index(tx_wr_index),
+		.rd_index(tx_rd_index),
+		.watermark(tx_watermark)
+	);
+
+	fifo #(
+		.ADDR_WIDTH(RX_ADDR_WIDTH),
+		.WIDTH(13)
+	) rx_fifo(
+		.clk(clk),
+		.reset(resetn),
+		.wr_data(rx_data_out),
+		.wr_request(rx_fifo_wr_request),
+		.rd_data(rx_latch_data),
+		.rd_request(rx_fifo_pop),
+		.empty(rx_fifo_empty),
+		.full(rx_fifo_full),
+		.overflow(rx_fifo_overflow),
+		.clear_overflow_request(rx_clear_overflow),
+		.wr_index(rx_wr_index),
+		.rd_index(rx_rd_index),
+		.watermark(rx_watermark)
+	);
+
+	// Edge detector instantation
+	// (receiver side only; the transmitter pops with a one-clock pulse and the
+	// bus side pushes and pops in the handshake clock)
+	edge_detector rx_wr_edge_det(
+		.clk(clk),
+		.reset(resetn),
+		.signal_in(rx_wr_request),
+		.signal_out(rx_fifo_wr_request)
+	);
+
+	// Baud Rate Generator instantation
+	brd serial_brd (
+		.clk(clk),
+		.reset(resetn),
+		.enable(control[4]),
+		.ibrd(ibrd),
+		.fbrd(fbrd),
+		.out(brd_out)
+);
+    assign status = {4'b0, rts, cts, tx_low, rx_ne, rx_pack_count, tx_watermark_field, rx_err_pending, rx_timeout, rx_trigger, rx_watermark_field,
+					rx_pe, rx_fe, tx_fifo_overflow, tx_fifo_empty,
+					tx_fifo_full,rx_fifo_overflow,rx_fifo_empty,rx_fifo_full};
+	assign CLK_OUT = brd_out & control[5];
+	assign intr_request = (control[6] & rx_trigger) | (control[9] & rx_timeout) | (control[7] & status[4])
+	                    | (control[15] & tx_low);
+					// INT_ON_RX and RX trigger level reached
+					// INT_ON_RX_TIMEOUT and RX timeout
+					// INT_ON_TX and TXFE set
+					// INT_ON_TX_LOW and TX FIFO at or below the low watermark
+	assign intr = intr_out;
+
+	// Interrupt moderation: each new assertion of intr starts a window of
+	// imod[15:0] microseconds, and a request that arrives (or returns after
+	// being serviced) inside the window waits for it to close; the line is
+	// level sensitive, so nothing is lost, only batched
+	always_ff @ (posedge clk)
+	begin
+		if (resetn == 1'b0)
+		begin
+			us_div <= 8'b0;
+			us_tick <= 1'b0;
+			imod_left <= 16'b0;
+			intr_out <= 1'b0;
+		end
+		else
+		begin
+			us_tick <= (us_div == C_CLK_MHZ - 1);
+			us_div <= (us_div == C_CLK_MHZ - 1) ? 8'b0 : us_div + 1;
+			if (imod_left != 0 && us_tick)
+				imod_left <= imod_left - 1;
+			if (!intr_request)
+				intr_out <= 1'b0;
+			else if (!intr_out && imod_left == 0)
+			begin
+				intr_out <= 1'b1;
+				imod_left <= imod[15:0];
+			end
+		end
+	end
+
+	// CTS synchronizer
+	always_ff @ (posedge clk)
+	begin
+		if (resetn == 1'b0)
+			cts_sync <= 2'b0;
+		else
+			cts_sync <= {cts_sync[0], ~cts_n};
+	end
+
+	// Flagged RX FIFO entries
+	wire rx_push_err = rx_fifo_wr_request && ~rx_fifo_full && rx_data_out[11:9] != 3'b0;
+	wire rx_pop_err = rx_fifo_pop && ~rx_fifo_empty && rx_head_flags[2:0] != 3'b0;
+	always_ff @ (posedge clk)
+	begin
+		if (resetn == 1'b0)
+			rx_err_count <= 0;
+		else
+		begin
+			if (rx_push_err && !rx_pop_err)
+				rx_err_count <= rx_err_count + 1;
+			else if (rx_pop_err && !rx_push_err)
+				rx_err_count <= rx_err_count - 1;
+		end
+	end
+
+	// RX character timeout: count baud ticks since the last RX FIFO push or pop
+	// (or, with RX DMA, since the last push)
+	always_ff @ (posedge clk)
+	begin
+		if (resetn == 1'b0)
+		begin
+			rx_idle_ticks <= 20'b0;
+			rx_timeout <= 1'b0;
+			rx_dma_pending <= 1'b0;
+		end
+		else
+		begin
+			if (rx_dma_enable)
+			begin
+				if (rx_fifo_wr_request)
+				begin
+					rx_idle_ticks <= 20'b0;
+					rx_dma_pending <= 1'b1;
+				end
+				else if (!rx_dma_pending)
+					rx_idle_ticks <= 20'b0;
+				else if (brd_out)
+				begin
+					if (rx_timeout_chars != 0 && rx_idle_ticks >= rx_timeout_chars * char_ticks)
+					begin
+						rx_timeout <= 1'b1;
+						rx_dma_pending <= 1'b0;
+					end
+					else
+						rx_idle_ticks <= rx_idle_ticks + 1;
+				end
+				if (rx_timeout_clear)
+					rx_timeout <= 1'b0;
+			end
+			else
+			begin
+				rx_dma_pending <= 1'b0;
+				if (rx_fifo_empty || rx_fifo_wr_request || rx_fifo_pop)
+				begin
+					rx_idle_ticks <= 20'b0;
+					rx_timeout <= 1'b0;
+				end
+				else if (brd_out)
+				begin
+					if (rx_timeout_chars != 0 && rx_idle_ticks >= rx_timeout_chars * char_ticks)
+						rx_timeout <= 1'b1;
+					else
+						rx_idle_ticks <= rx_idle_ticks + 1;
+				end
+			end
+		end
+	end
+
+	// Transmitter instantation
+	transmitter tx_serializer(
+		.clk(clk),
+		.reset(resetn),
+		.brgen(brd_out),
+		.osr(osr),
+		.enable(control[4]),
+		.size(control[1:0]),
+		.stop2(control[8]),
+		.parity(control[3:2]),
+		.fifo_empty(tx_fifo_empty),
+		.hold(tx_hold),
+		.data(tx_fifo_data_in),
+		.data_request(tx_fifo_rd_request),
+		.out(tx_line)
+	);
+
+	// Receiver instantation
+	receiver rx_deserializer(
+		.clk(clk),
+		.reset(resetn),
+		.brgen(brd_out),
+		.osr(osr),
+		.enable(control[4]),
+		.size(control[1:0]),
+		.stop2(control[8]),
+		.parity(control[3:2]),
+		.fe(rx_fe),
+		.pe(rx_pe),
+		.ne(rx_ne),
+		.clear_fe(clear_fe),
+		.clear_pe(clear_pe),
+		.clear_ne(clear_ne),
+		.data(rx_data_out),
+		.data_request(rx_wr_request),
+		.in(rx_line)
+	);
+
+	// Packed writes: shift the strobed lanes into the TX FIFO one per clock
+	always_ff @ (posedge clk)
+	begin
+		if (resetn == 1'b0)
+		begin
+			tx_pack_lanes <= 4'b0;
+			tx_pack_push <= 1'b0;
+		end
+		else
+		begin
+			tx_pack_push <= 1'b0;
+			if (wr && waddr == PACKED_REG)
+			begin
+				tx_pack_data <= wdata;
+				tx_pack_lanes <= wstrb;
+			end
+			else if (tx_pack_lanes != 4'b0)
+			begin
+				tx_pack_push <= tx_pack_lanes[0];
+				tx_pack_byte <= {1'b0, tx_pack_data[7:0]};
+				tx_pack_data <= tx_pack_data >> 8;
+				tx_pack_lanes <= tx_pack_lanes >> 1;
+			end
+		end
+	end
+
+	// Packed reads: pop the FIFO head into successive lanes one per clock
+	always_ff @ (posedge clk)
+	begin
+		if (resetn == 1'b0)
+		begin
+			rx_unpack_count <= 3'b0;
+			rx_unpack_lane <= 2'b0;
+			rx_pack_count <= 3'b0;
+			rx_pack_done <= 1'b0;
+		end
+		else
+		begin
+			rx_pack_done <= 1'b0;
+			if (rd && raddr == PACKED_REG)
+			begin
+				rx_pack_data <= 32'b0;
+				rx_pack_count <= rx_pack_avail;
+				rx_unpack_count <= rx_pack_avail;
+				rx_unpack_lane <= 2'b0;
+				rx_pack_done <= (rx_pack_avail == 3'b0);
+			end
+			else if (rx_unpack_pop)
+			begin
+				rx_pack_data[rx_unpack_lane*8 +: 8] <= rx_latch_data[7:0];
+				rx_unpack_lane <= rx_unpack_lane + 1;
+				rx_unpack_count <= rx_unpack_count - 1;
+				rx_pack_done <= (rx_unpack_count == 3'd1);
+			end
+		end
+	end
+
+    // Write data to internal registers in the handshake clock (wr)
+    // write correct bytes in 32-bit word based on byte enables (wstrb)
+    // (data, status and packed writes are handled by the FIFO, w1c and
+    // packed logic above)
+    always_ff @ (posedge clk)
+    begin
+        if (resetn == 1'b0)
+        begin
+            control <= 32'b0;
+            brd <= 32'b0;
+            rxcfg <= 32'b0;
+            txcfg <= 32'b0;
+            imod <= 32'b0;
+            flow <= 32'b0;
+        end
+        else if (wr)
+        begin
+            case (waddr)
+                CONTROL_REG:
+                    control <= ((control & ~wstrb_mask) | (wdata & wstrb_mask)) & CONTROL_BITS;
+                BRD_REG:
+                    brd <= (brd & ~wstrb_mask) | (wdata & wstrb_mask);
+                RXCFG_REG:
+                    rxcfg <= (rxcfg & ~wstrb_mask) | (wdata & wstrb_mask);
+                TXCFG_REG:
+                    txcfg <= ((txcfg & ~wstrb_mask) | (wdata & wstrb_mask)) & 32'h0000FFFF;
+                IMOD_REG:
+                    imod <= ((imod & ~wstrb_mask) | (wdata & wstrb_mask)) & 32'h0000FFFF;
+                FLOW_REG:
+                    flow <= ((flow & ~wstrb_mask) | (wdata & wstrb_mask)) & 32'h0000FFFF;
+                default:
+                    ;
+            endcase
+        end
+    end
+
+    // Register read data for raddr
+    always_comb
+    begin
+		case (raddr)
+		    DATA_REG:
+				rdata = {23'b0, rx_latch_data[8:0]};
+		    STATUS_REG:
+				rdata = status;
+		    CONTROL_REG:
+		        rdata = control;
+		    BRD_REG:
+			     rdata = brd;
+		    CAP_REG:
+			     rdata = cap;
+		    LEVEL_REG:
+			     rdata = level;
+		    RXCFG_REG:
+			     rdata = rxcfg;
+		    RXD_REG:
+			     rdata = rxd;
+		    TXCFG_REG:
+			     rdata = txcfg;
+		    IMOD_REG:
+			     rdata = imod;
+		    FLOW_REG:
+			     rdata = flow;
+		    default:
+			     rdata = 32'b0;
+		endcase
+    end
+
+endmodule
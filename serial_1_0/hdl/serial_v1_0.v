@@ -4,6 +4,15 @@
 	module serial_v1_0 #
 	(
 		// Users to add parameters here
+		// Serial channels behind the one AXI slave (1 to 16); channel n is
+		// at offset n * 64 and C_AXI_ADDR_WIDTH must cover them
+		parameter integer C_NUM_CHANNELS	= 1,
+		// FIFO depths in entries (power of 2, 16 to 4096)
+		parameter integer C_RX_FIFO_DEPTH	= 16,
+		parameter integer C_TX_FIFO_DEPTH	= 16,
+		// AXI clock in MHz (10 to 250), the interrupt moderation timebase;
+		// CLK_FREQ in serial_regs.h must match
+		parameter integer C_CLK_MHZ	= 100,
 
 		// User parameters ends
 		// Do not modify the parameters beyond this line
@@ -11,14 +20,27 @@
 
 		// Parameters of Axi Slave Bus Interface AXI
 		parameter integer C_AXI_DATA_WIDTH	= 32,
-		parameter integer C_AXI_ADDR_WIDTH	= 4
+		parameter integer C_AXI_ADDR_WIDTH	= 6
 	)
 	(
 		// Users to add ports here
         output wire intr,
-        output wire CLK_OUT,
-        output wire tx_out,
-        input wire rx_in,
+        output wire [C_NUM_CHANNELS-1:0] CLK_OUT,
+        output wire [C_NUM_CHANNELS-1:0] tx_out,
+        input wire [C_NUM_CHANNELS-1:0] rx_in,
+        // RTS/CTS flow control (active low; tie cts_n low if unused)
+        output wire [C_NUM_CHANNELS-1:0] rts_n,
+        input wire [C_NUM_CHANNELS-1:0] cts_n,
+
+        // AXI4-stream data path for DMA on channel 0 (enabled by control
+        // bits 10 and 11)
+        input wire [7:0] s_axis_tx_tdata,
+        input wire s_axis_tx_tvalid,
+        output wire s_axis_tx_tready,
+        output wire [7:0] m_axis_rx_tdata,
+        output wire m_axis_rx_tvalid,
+        input wire m_axis_rx_tready,
+        output wire m_axis_rx_tlast,
 		// User ports ends
 		// Do not modify the ports beyond this line
 
@@ -48,7 +70,11 @@
 	);
 // Instantiation of Axi Bus Interface AXI
 	serial_v1_0_AXI # ( 
-		.C_S_AXI_ADDR_WIDTH(C_AXI_ADDR_WIDTH)
+		.C_S_AXI_ADDR_WIDTH(C_AXI_ADDR_WIDTH),
+		.C_NUM_CHANNELS(C_NUM_CHANNELS),
+		.C_RX_FIFO_DEPTH(C_RX_FIFO_DEPTH),
+		.C_TX_FIFO_DEPTH(C_TX_FIFO_DEPTH),
+		.C_CLK_MHZ(C_CLK_MHZ)
 	) serial_v1_0_AXI_inst (
 		.S_AXI_ACLK(axi_aclk),
 		.S_AXI_ARESETN(axi_aresetn),
@@ -74,6 +100,15 @@
 		.CLK_OUT(CLK_OUT),
 		.tx_out(tx_out),
 		.rx_in(rx_in),
+		.rts_n(rts_n),
+		.cts_n(cts_n),
+		.S_AXIS_TX_TDATA(s_axis_tx_tdata),
+		.S_AXIS_TX_TVALID(s_axis_tx_tvalid),
+		.S_AXIS_TX_TREADY(s_axis_tx_tready),
+		.M_AXIS_RX_TDATA(m_axis_rx_tdata),
+		.M_AXIS_RX_TVALID(m_axis_rx_tvalid),
+		.M_AXIS_RX_TREADY(m_axis_rx_tready),
+		.M_AXIS_RX_TLAST(m_axis_rx_tlast),
         .intr(intr)
 	);
 
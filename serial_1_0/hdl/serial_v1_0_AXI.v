@@ -5,23 +5,47 @@
 // Contains:
 // AXI4-lite interface
 // Serial memory-mapped interface
-// Serial port interface and implemention
+// Serial port interface and implemention (serial_channel.sv, one per channel)
 
 `timescale 1 ns / 1 ps
 
     module serial_v1_0_AXI #
     (
-        // Bit width of S_AXI address bus
-        parameter integer C_S_AXI_ADDR_WIDTH = 4
+        // Bit width of S_AXI address bus (at least 6 + log2 C_NUM_CHANNELS)
+        parameter integer C_S_AXI_ADDR_WIDTH = 6,
+        // Number of serial channels behind this slave (1 to 16)
+        parameter integer C_NUM_CHANNELS = 1,
+        // FIFO depths in entries (power of 2, 16 to 4096)
+        parameter integer C_RX_FIFO_DEPTH = 16,
+        parameter integer C_TX_FIFO_DEPTH = 16,
+        // AXI clock in MHz, for the interrupt moderation timer (matches
+        // CLK_FREQ in serial_regs.h)
+        parameter integer C_CLK_MHZ = 100
     )
     (
         // Ports to top level module (what makes this the GPIO IP module)
-		output wire CLK_OUT,
-		output wire tx_out,
-		input wire rx_in,
+        // Bit n of the line ports belongs to channel n
+		output wire [C_NUM_CHANNELS-1:0] CLK_OUT,
+		output wire [C_NUM_CHANNELS-1:0] tx_out,
+		input wire [C_NUM_CHANNELS-1:0] rx_in,
+		// RTS/CTS flow control (active low)
+		output wire [C_NUM_CHANNELS-1:0] rts_n,
+		input wire [C_NUM_CHANNELS-1:0] cts_n,
 		
+        // Shared by all channels; ipend says which ones are requesting
         output wire intr,
 
+        // AXI4-stream TX input (DMA MM2S), channel 0
+        input wire [7:0] S_AXIS_TX_TDATA,
+        input wire S_AXIS_TX_TVALID,
+        output wire S_AXIS_TX_TREADY,
+
+        // AXI4-stream RX output (DMA S2MM), channel 0
+        output wire [7:0] M_AXIS_RX_TDATA,
+        output wire M_AXIS_RX_TVALID,
+        input wire M_AXIS_RX_TREADY,
+        output wire M_AXIS_RX_TLAST,
+
         // AXI clock and reset        
         input wire S_AXI_ACLK,
         input wire S_AXI_ARESETN,
@@ -58,66 +82,45 @@
         input wire S_AXI_RREADY
     );
 
-    // Internals
-    reg [31:0] status; 
-    reg [31:0] control;
-    reg [31:0] brd;
-	
-	
-	// Transmitter
-	 reg [8:0] tx_latch_data;
-	 reg tx_fifo_wr_request, tx_fifo_rd_request;
-	 reg tx_wr_request, tx_rd_request;
-	 reg [8:0] tx_fifo_data_in;
-	 wire tx_fifo_empty, tx_fifo_full, tx_fifo_overflow;
-	 reg tx_clear_overflow;
-	 wire [4:0] tx_wr_index, tx_rd_index, tx_watermark;
-	
-	// Receiver
-	reg [8:0] rx_latch_data;
-	 reg rx_fifo_wr_request, rx_fifo_rd_request;
-	 reg rx_wr_request, rx_rd_request;
-	 reg [8:0] rx_data_out;
-	 wire rx_fifo_empty, rx_fifo_full, rx_fifo_overflow;
-	 reg rx_clear_overflow, clear_pe, clear_fe;
-	 wire [4:0]rx_wr_index, rx_rd_index, rx_watermark;
-	 wire rx_fe,rx_pe;
-	
-	// Status Register w1c
-	reg [31:0] status_w1c;
-	assign status_w1c = {24'b0, clear_pe, clear_fe, tx_clear_overflow, 2'b0, rx_clear_overflow, 2'b0};
-	
-	// Baud Rate Register
-	wire [23:0]ibrd;
-	wire [7:0]fbrd;
-	wire brd_out;
-	assign ibrd = brd[31:8];
-	assign fbrd = brd[7:0];
-    
-    // Register map
-    // ofs  fn
-    //   0  data (r/w)
-    //   4  status (r/w1c)
-    //   8  control (r/w)
-    //  12  brd (r/w)
-    
-    // Register numbers
-    localparam integer DATA_REG		= 3'b000;
-    localparam integer STATUS_REG	= 3'b001;
-    localparam integer CONTROL_REG	= 3'b010;
-    localparam integer BRD_REG		= 3'b011;
-    
-    
+    // Address map
+    // Channel n occupies the 64 byte window at n * 64, with the register
+    // map in serial_channel.sv. Word 15 of every window (offset 60) reads
+    // the interrupt pending register:
+    //   [15:0] bit n set while channel n drives its (moderated) interrupt
+    // so one read at offset 60 tells the driver which channels to service.
+    // Windows above the last channel read as zero and ignore writes
+    localparam integer IPEND_REG = 4'b1111;
+    localparam integer PACKED_REG = 4'b0111;
+
+    // Per-channel register ports
+    wire [31:0] ch_rdata [0:C_NUM_CHANNELS-1];
+    wire [31:0] ch_pack_data [0:C_NUM_CHANNELS-1];
+    wire [C_NUM_CHANNELS-1:0] ch_tx_pack_busy;
+    wire [C_NUM_CHANNELS-1:0] ch_rx_unpack_busy;
+    wire [C_NUM_CHANNELS-1:0] ch_pack_done;
+    wire [C_NUM_CHANNELS-1:0] ch_intr;
+    wire [C_NUM_CHANNELS-1:0] ch_tx_tready;
+    wire [7:0] ch_rx_tdata [0:C_NUM_CHANNELS-1];
+    wire [C_NUM_CHANNELS-1:0] ch_rx_tvalid;
+    wire [C_NUM_CHANNELS-1:0] ch_rx_tlast;
+
+    // Packed accesses stall the whole slave; only one is ever in progress
+    wire tx_pack_busy = |ch_tx_pack_busy;
+    wire rx_unpack_busy = |ch_rx_unpack_busy;
+    wire rx_pack_done = |ch_pack_done;
+    reg [31:0] rx_pack_data;
+
+    // Interrupt pending register and the shared interrupt line
+    wire [31:0] ipend = {{(32-C_NUM_CHANNELS){1'b0}}, ch_intr};
+    assign intr = |ch_intr;
+
     // AXI4-lite signals
-    reg axi_awready;
-    reg axi_wready;
     reg [1:0] axi_bresp;
     reg axi_bvalid;
-    reg axi_arready;
     reg [31:0] axi_rdata;
     reg [1:0] axi_rresp;
     reg axi_rvalid;
-    
+
     // friendly clock, reset, and bus signals from master
     wire axi_clk           = S_AXI_ACLK;
     wire axi_resetn        = S_AXI_ARESETN;
@@ -128,8 +131,17 @@
     wire axi_bready        = S_AXI_BREADY;
     wire [31:0] axi_araddr = S_AXI_ARADDR;
     wire axi_arvalid       = S_AXI_ARVALID;
-    wire axi_rready        = S_AXI_RREADY;    
-    
+    wire axi_rready        = S_AXI_RREADY;
+
+    // Accept a write when address and data are both valid and the response
+    // slot is free (or being emptied this clock), and a read when the read
+    // data slot is free; ready is combinational so back-to-back transactions
+    // complete at one per clock. Packed accesses hold ready low while their
+    // bytes move through the FIFO one per clock
+    wire axi_awready = axi_awvalid && axi_wvalid && (~axi_bvalid || axi_bready) && ~tx_pack_busy;
+    wire axi_wready  = axi_awready;
+    wire axi_arready = (~axi_rvalid || axi_rready) && ~rx_unpack_busy;
+
     // assign bus signals to master to internal reg names
     assign S_AXI_AWREADY = axi_awready;
     assign S_AXI_WREADY  = axi_wready;
@@ -140,339 +152,136 @@
     assign S_AXI_RRESP   = axi_rresp;
     assign S_AXI_RVALID  = axi_rvalid;
 
-	// FIFO instantation 
-	fifo16x9 tx_fifo(
-		.clk(axi_clk),                  
-		.reset(axi_resetn),                 
-		.wr_data(tx_latch_data),        
-		.wr_request(tx_fifo_wr_request), 
-		.rd_data(tx_fifo_data_in),    
-		.rd_request(tx_fifo_rd_request),     
-		.empty(tx_fifo_empty),           
-		.full(tx_fifo_full),           
-		.overflow(tx_fifo_overflow),     
-		.clear_overflow_request(tx_clear_overflow),
-		.wr_index(tx_wr_index),       
-		.rd_index(tx_rd_index),      
-		.watermark(tx_watermark) 
-	);
-	
-	fifo16x9 rx_fifo(
-		.clk(axi_clk),                  
-		.reset(axi_resetn),                 
-		.wr_data(rx_data_out),        
-		.wr_request(rx_fifo_wr_request), 
-		.rd_data(rx_latch_data),    
-		.rd_request(rx_fifo_rd_request),     
-		.empty(rx_fifo_empty),           
-		.full(rx_fifo_full),           
-		.overflow(rx_fifo_overflow),     
-		.clear_overflow_request(rx_clear_overflow),
-		.wr_index(rx_wr_index),       
-		.rd_index(rx_rd_index),      
-		.watermark(rx_watermark) 
-	);
-	
-	// Edge detectors instantation
-	edge_detector tx_wr_edge_det(
-		.clk(axi_clk),
-		.reset(axi_resetn),
-		.signal_in(tx_wr_request),
-		.signal_out(tx_fifo_wr_request)
-	);
-	
-	edge_detector tx_rd_edge_det(
-		.clk(axi_clk),
-		.reset(axi_resetn),
-		.signal_in(tx_rd_request),
-		.signal_out(tx_fifo_rd_request)
-	);
-	
-	edge_detector rx_wr_edge_det(
-		.clk(axi_clk),
-		.reset(axi_resetn),
-		.signal_in(rx_wr_request),
-		.signal_out(rx_fifo_wr_request)
-	);
-	
-	edge_detector rx_rd_edge_det(
-		.clk(axi_clk),
-		.reset(axi_resetn),
-		.signal_in(rx_rd_request),
-		.signal_out(rx_fifo_rd_request)
-	);
-	
-	// Baud Rate Generator instantation
-	brd serial_brd (
-		.clk(axi_clk),
-		.enable(control[4]),
-		.ibrd(ibrd),
-		.fbrd(fbrd),
-		.out(brd_out)
-);
-    assign status = {11'b0, tx_watermark, 3'b0, rx_watermark, 
-					rx_pe, rx_fe, tx_fifo_overflow, tx_fifo_empty, 
-					tx_fifo_full,rx_fifo_overflow,rx_fifo_empty,rx_fifo_full};
-	assign CLK_OUT = brd_out & control[5];
-	assign intr = (control[6] & ~status[1]) | (control[7] & status[4]);  // INT_ON_RX and RXFE clear
-                    // INT_ON_TX and TXFE set
+    // Handshakes, decoded channel and register numbers
+    wire wr = axi_awvalid && axi_awready;
+    wire rd = axi_arvalid && axi_arready;
+    wire [3:0] waddr = axi_awaddr[5:2];
+    wire [3:0] raddr = axi_araddr[5:2];
+    wire [3:0] wchan = axi_awaddr[9:6];
+    wire [3:0] rchan = axi_araddr[9:6];
+    wire rchan_valid = rchan < C_NUM_CHANNELS;
 
-	assign control[31:9] = 13'b0;
-	
-	// Transmitter instantation
-	transmitter tx_serializer(
-		.clk(axi_clk),  
-		.reset(axi_resetn),
-		.brgen(brd_out),            
-		.enable(control[4]),           
-		.size(control[1:0]),       
-		.stop2(control[8]),            
-		.parity(control[3:2]),    
-		.fifo_empty(tx_fifo_empty),      
-		.data(tx_fifo_data_in),     
-		.data_request(tx_rd_request),    
-		.out(tx_out)          
-	);
+	// Channel instantiation
+	// The stream ports serve channel 0; the other channels are PIO only
+	genvar n;
+	generate
+		for (n = 0; n < C_NUM_CHANNELS; n = n + 1) begin : g_channel
+			serial_channel #(
+				.C_RX_FIFO_DEPTH(C_RX_FIFO_DEPTH),
+				.C_TX_FIFO_DEPTH(C_TX_FIFO_DEPTH),
+				.C_CLK_MHZ(C_CLK_MHZ),
+				.C_CHANNEL(n),
+				.C_NUM_CHANNELS(C_NUM_CHANNELS),
+				.C_HAS_STREAM(n == 0)
+			) channel (
+				.clk(axi_clk),
+				.resetn(axi_resetn),
+				.wr(wr && wchan == n),
+				.waddr(waddr),
+				.wdata(S_AXI_WDATA),
+				.wstrb(axi_wstrb),
+				.rd(rd && rchan == n),
+				.raddr(raddr),
+				.rdata(ch_rdata[n]),
+				.tx_pack_busy(ch_tx_pack_busy[n]),
+				.rx_unpack_busy(ch_rx_unpack_busy[n]),
+				.rx_pack_done(ch_pack_done[n]),
+				.rx_pack_data(ch_pack_data[n]),
+				.intr(ch_intr[n]),
+				.CLK_OUT(CLK_OUT[n]),
+				.tx_out(tx_out[n]),
+				.rx_in(rx_in[n]),
+				.rts_n(rts_n[n]),
+				.cts_n(cts_n[n]),
+				.S_AXIS_TX_TDATA(n == 0 ? S_AXIS_TX_TDATA : 8'b0),
+				.S_AXIS_TX_TVALID(n == 0 ? S_AXIS_TX_TVALID : 1'b0),
+				.S_AXIS_TX_TREADY(ch_tx_tready[n]),
+				.M_AXIS_RX_TDATA(ch_rx_tdata[n]),
+				.M_AXIS_RX_TVALID(ch_rx_tvalid[n]),
+				.M_AXIS_RX_TREADY(n == 0 ? M_AXIS_RX_TREADY : 1'b0),
+				.M_AXIS_RX_TLAST(ch_rx_tlast[n])
+			);
+		end
+	endgenerate
 
-	// Receiver instantation
-	receiver rx_deserializer(
-		.clk(axi_clk),
-		.reset(axi_resetn),
-		.brgen(brd_out),
-		.enable(control[4]),
-		.size(control[1:0]),
-		.stop2(control[8]),              
-		.parity(control[3:2]),        
-		.fe(rx_fe),
-		.pe(rx_pe),
-		.clear_fe(clear_fe),
-		.clear_pe(clear_pe),
-		.data(rx_data_out),          
-		.data_request(rx_wr_request),         
-		.in(rx_in) 
-	);
-	
-    // Assert address ready handshake (axi_awready) 
-    // - after address is valid (axi_awvalid)
-    // - after data is valid (axi_wvalid)
-    // - while configured to receive a write (aw_en)
-    // De-assert ready (axi_awready)
-    // - after write response channel ready handshake received (axi_bready)
-    // - after this module sends write response channel valid (axi_bvalid) 
-    wire wr_add_data_valid = axi_awvalid && axi_wvalid;
-    reg aw_en;
-    always_ff @ (posedge axi_clk)
-    begin
-        if (axi_resetn == 1'b0)
-        begin
-            axi_awready <= 1'b0;
-            aw_en <= 1'b1;
-        end
-        else
-        begin
-            if (wr_add_data_valid && ~axi_awready && aw_en)
-            begin
-                axi_awready <= 1'b1;
-                aw_en <= 1'b0;
-            end
-            else if (axi_bready && axi_bvalid)
-                begin
-                    aw_en <= 1'b1;
-                    axi_awready <= 1'b0;
-                end
-            else           
-                axi_awready <= 1'b0;
-        end 
-    end
-
-    // Capture the write address (axi_awaddr) in the first clock (~axi_awready)
-    // - after write address is valid (axi_awvalid)
-    // - after write data is valid (axi_wvalid)
-    // - while configured to receive a write (aw_en)
-    reg [C_S_AXI_ADDR_WIDTH-1:0] waddr;
-    always_ff @ (posedge axi_clk)
-    begin
-        if (axi_resetn == 1'b0)
-            waddr <= 0;
-        else if (wr_add_data_valid && ~axi_awready && aw_en)
-            waddr <= axi_awaddr;
-    end
-
-    // Output write data ready handshake (axi_wready) generation for one clock
-    // - after address is valid (axi_awvalid)
-    // - after data is valid (axi_wvalid)
-    // - while configured to receive a write (aw_en)
-    always_ff @ (posedge axi_clk)
-    begin
-        if (axi_resetn == 1'b0)
-            axi_wready <= 1'b0;
-        else
-            axi_wready <= (wr_add_data_valid && ~axi_wready && aw_en);
-    end       
-
-    // Write data to internal registers
-    // - after address is valid (axi_awvalid)
-    // - after write data is valid (axi_wvalid)
-    // - after this module asserts ready for address handshake (axi_awready)
-    // - after this module asserts ready for data handshake (axi_wready)
-    // write correct bytes in 32-bit word based on byte enables (axi_wstrb)
-    // int_clear_request write is only active for one clock
-    wire wr = wr_add_data_valid && axi_awready && axi_wready;
-    integer byte_index;
-    always_ff @ (posedge axi_clk)
-    begin
-        if (axi_resetn == 1'b0)
-        begin
-            tx_latch_data <= 9'b0;
-            status <= 32'b0;
-            control <= 32'b0;
-            brd <= 32'b0;
-        end 
-        else 
-        begin
-            if (wr)
-            begin
-                case (axi_awaddr[3:2])
-                    DATA_REG:
-							begin
-								tx_latch_data <= S_AXI_WDATA[8:0];
-								tx_wr_request <= 1'b1;
-							end
-                    STATUS_REG:
-                        for (byte_index = 0; byte_index <= 2; byte_index = byte_index+1)
-                            if (axi_wstrb[byte_index] == 1)
-								status_w1c[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
-								
-                    CONTROL_REG: 
-                        for (byte_index = 0; byte_index <= 2; byte_index = byte_index+1)
-                            if (axi_wstrb[byte_index] == 1)
-                                control[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
-                    BRD_REG:
-                        for (byte_index = 0; byte_index <= 2; byte_index = byte_index+1)
-                            if (axi_wstrb[byte_index] == 1)
-                                brd[(byte_index*8) +: 8] <= S_AXI_WDATA[(byte_index*8) +: 8];
-                    
-                endcase
-            end
-            else begin
-                //int_clear_request <= 32'b0;
-				tx_wr_request <= 1'b0;
-				status_w1c <= 32'b0;
-				end
-        end
-    end    
+	assign S_AXIS_TX_TREADY = ch_tx_tready[0];
+	assign M_AXIS_RX_TDATA = ch_rx_tdata[0];
+	assign M_AXIS_RX_TVALID = ch_rx_tvalid[0];
+	assign M_AXIS_RX_TLAST = ch_rx_tlast[0];
 
     // Send write response (axi_bvalid, axi_bresp)
-    // - after address is valid (axi_awvalid)
-    // - after write data is valid (axi_wvalid)
-    // - after this module asserts ready for address handshake (axi_awready)
-    // - after this module asserts ready for data handshake (axi_wready)
-    // Clear write response valid (axi_bvalid) after one clock
-    wire wr_add_data_ready = axi_awready && axi_wready;
+    // - in the clock after a write is accepted (wr)
+    // Clear write response valid (axi_bvalid)
+    // - after master ready handshake is received (axi_bready) with no new write
     always_ff @ (posedge axi_clk)
     begin
         if (axi_resetn == 1'b0)
         begin
             axi_bvalid  <= 0;
             axi_bresp   <= 2'b0;
-        end 
+        end
         else
-        begin    
-            if (wr_add_data_valid && wr_add_data_ready && ~axi_bvalid)
+        begin
+            if (wr)
             begin
                 axi_bvalid <= 1'b1;
                 axi_bresp  <= 2'b0;
             end
-            else if (S_AXI_BREADY && axi_bvalid) 
-                axi_bvalid <= 1'b0; 
+            else if (axi_bready && axi_bvalid)
+                axi_bvalid <= 1'b0;
         end
-    end   
+    end
 
-    // In the first clock (~axi_arready) that the read address is valid
-    // - capture the address (axi_araddr)
-    // - output ready (axi_arready) for one clock
-    reg [C_S_AXI_ADDR_WIDTH-1:0] raddr;
-    always_ff @ (posedge axi_clk)
+    // Register read data for the accepted address, and the packed read data
+    // of whichever channel is completing one
+    reg [31:0] rd_mux;
+    integer i;
+    always_comb
     begin
-        if (axi_resetn == 1'b0)
-        begin
-            axi_arready <= 1'b0;
-            raddr <= 32'b0;
-        end 
+        if (raddr == IPEND_REG)
+            rd_mux = ipend;
+        else if (rchan_valid)
+            rd_mux = ch_rdata[rchan];
         else
-        begin    
-            // if valid, pulse ready (axi_rready) for one clock and save address
-            if (axi_arvalid && ~axi_arready)
-            begin
-                axi_arready <= 1'b1;
-                raddr  <= axi_araddr;
-            end
-            else
-                axi_arready <= 1'b0;
-        end 
-    end       
-        
-    // Update register read data
-    // - after this module receives a valid address (axi_arvalid)
-    // - after this module asserts ready for address handshake (axi_arready)
-    // - before the module asserts the data is valid (~axi_rvalid)
-    //   (don't change the data while asserting read data is valid)
-    wire rd = axi_arvalid && axi_arready && ~axi_rvalid;
-    always_ff @ (posedge axi_clk)
-    begin
-        if (axi_resetn == 1'b0)
-        begin
-            axi_rdata <= 32'b0;
-        end 
-        else
-        begin    
-            if (rd)
-            begin
-		// Address decoding for reading registers
-		case (raddr[3:2])
-		    DATA_REG: 
-				begin
-					axi_rdata <= {23'b0, rx_latch_data};
-					rx_rd_request <= 1'b1;
-				end
-		    STATUS_REG:
-				begin
-					axi_rdata <= status;	
-				end
-		    CONTROL_REG: 
-		        axi_rdata <= control;
-		    BRD_REG: 
-			     axi_rdata <= brd;
-		endcase
-            end 
-              else begin
-				rx_rd_request <= 1'b0;
-				end
-        end
-    end    
+            rd_mux = 32'b0;
+
+        rx_pack_data = 32'b0;
+        for (i = 0; i < C_NUM_CHANNELS; i = i + 1)
+            if (ch_pack_done[i])
+                rx_pack_data = ch_pack_data[i];
+    end
 
     // Assert data is valid for reading (axi_rvalid)
-    // - after address is valid (axi_arvalid)
-    // - after this module asserts ready for address handshake (axi_arready)
-    // De-assert data valid (axi_rvalid) 
-    // - after master ready handshake is received (axi_rready)
+    // - in the clock after a read is accepted (rd), except for packed reads
+    //   of a channel, which return when its unpack sequence completes
+    //   (rx_pack_done)
+    // De-assert data valid (axi_rvalid)
+    // - after master ready handshake is received (axi_rready) with no new read
     always_ff @ (posedge axi_clk)
     begin
         if (axi_resetn == 1'b0)
+        begin
             axi_rvalid <= 1'b0;
+            axi_rdata <= 32'b0;
+            axi_rresp <= 2'b0;
+        end
         else
         begin
-            if (axi_arvalid && axi_arready && ~axi_rvalid)
+            if (rd && (raddr != PACKED_REG || !rchan_valid))
+            begin
+                axi_rvalid <= 1'b1;
+                axi_rdata <= rd_mux;
+                axi_rresp <= 2'b0;
+            end
+            else if (rx_pack_done)
             begin
                 axi_rvalid <= 1'b1;
+                axi_rdata <= rx_pack_data;
                 axi_rresp <= 2'b0;
-            end   
+            end
             else if (axi_rvalid && axi_rready)
                 axi_rvalid <= 1'b0;
         end
-    end    
-	
-endmodule
-
-
+    end
 
+endmodule
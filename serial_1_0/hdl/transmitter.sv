@@ -1,14 +1,16 @@
 module transmitter (
     input wire clk,              // System clock
 	input wire reset,
-    input wire brgen,            // Baud rate generator output
+    input wire brgen,            // Baud rate tick (one clock wide)
+    input wire [1:0] osr,        // Ticks per bit: 00 - 16, 01 - 8, 10 - 4
     input wire enable,           // Enable signal for transmission
     input wire [1:0] size,       // Data size (5 to 8 bits)
     input wire stop2,            // Stop bit control (1 or 2 stop bits)
     input wire [1:0] parity,     // Parity control (00 - None, 01 - Even, 10 - Odd)
     input wire fifo_empty,       // FIFO empty flag
-    input wire [8:0] data,       // Data to be transmitted
-    output reg data_request,     // Read request for FIFO
+    input wire hold,             // Do not start a frame (CTS deasserted)
+    input wire [8:0] data,       // FIFO head entry (first word fall through)
+    output reg data_request,     // FIFO pop, one clock wide
     output reg out               // Serial data output
 );
 
@@ -20,15 +22,27 @@ module transmitter (
     parameter PARITY_BIT = 3'b011;
     parameter STOP_BIT   = 3'b100;
 
-    logic [3:0] bit_count;            // Counter for data bits
-    reg [7:0] shift_reg;            // Shift register for data bits
+    logic [3:0] bit_count;            // Data bits started so far
+    reg [7:0] shift_reg;            // Data bits of the frame on the line
     reg parity_bit;                 // Calculated parity bit
-	reg [1:0] stop_bit;
-    logic [1:0] stop_bit_count;       // Counter for stop bits
+    logic stop_bit_count;             // Stop bits left after the current one
 
-    reg [3:0] counter;              // Counter for baud rate ticks (1/16)
-    reg brgen_old;                 // Previous value of brgen
+	// Frames go out back to back: the next FIFO entry is taken into next_data
+	// during the last stop bit and its start bit follows on the very next
+	// bit period, so the line never idles while the FIFO holds data
+	// hold only pauses between frames: a frame already started always
+	// completes, and a preloaded entry waits in next_data until hold drops
+	// Disabling the core abandons the frame on the line but keeps a
+	// preloaded entry, which has already left the FIFO; it goes out first
+	// once the core is enabled again (only reset discards it)
+    reg [7:0] next_data;
+    reg next_valid;
 
+    reg [3:0] counter;              // Counter for baud rate ticks within a bit
+    wire [3:0] last = 4'd15 >> osr; // Last tick of a bit
+    wire [3:0] data_bits = {2'b0, size} + 4'd5;
+
+	// Each bit starts on the tick that sets out and lasts last + 1 ticks
 	always_ff @ (posedge(clk))
     begin
         if ((reset == 1'b0) || !enable)
@@ -36,95 +50,100 @@ module transmitter (
             counter <= 0;
             state <= IDLE;
 			data_request <= 1'b0;
+			if (reset == 1'b0)
+				next_valid <= 1'b0;
 			out <= 1'b1; // Idle state for serial line (high)
         end else begin
-		if(enable) begin
-			brgen_old <= brgen;
-			if (brgen && !brgen_old) begin
+			data_request <= 1'b0;
+			if (brgen) begin
 				counter <= counter + 1;
 				
 			case (state)
 				IDLE: begin
 					out <= 1'b1; 
 					counter <= 0;
-					if (!fifo_empty)
+					if (!hold && (next_valid || !fifo_empty))
 					begin
+						out <= 1'b0;  // Start bit
+						shift_reg <= next_valid ? next_data : data[7:0];
+						data_request <= !next_valid;
+						next_valid <= 1'b0;
 						state <= START_BIT;
 					end
 				end
 
-				START_BIT: begin
-					out <= 1'b0;  // Start bit
-					shift_reg <= data;
-					if (counter == 4'd15) begin
-						state <= DATA_BITS;
-						bit_count <= 0;
-						counter <= 0;
-					end else state <= START_BIT;
+				START_BIT: 
+				if (counter == last) begin
+					counter <= 0;
+					out <= shift_reg[0];
+					bit_count <= 1;
+					state <= DATA_BITS;
 				end
 
 				DATA_BITS: 
-					if (counter == 4'd15) begin
+				if (counter == last) begin
 					counter <= 0;
-					out <= shift_reg[bit_count];
-					bit_count <= bit_count + 1;
-					if (bit_count == size + 5) begin // Adjust for size (00 for 5- 0b11 for 8 bits)
-						state <= (parity == 2'b00) ? STOP_BIT : PARITY_BIT;
-					end else begin
-						state <= DATA_BITS;
+					if (bit_count == data_bits) begin
+						if (parity == 2'b00) begin
+							out <= 1'b1;  // Stop bit(s) high
+							stop_bit_count <= stop2;
+							state <= STOP_BIT;
+						end else begin
+							out <= parity_bit;
+							state <= PARITY_BIT;
 						end
+					end else begin
+						out <= shift_reg[bit_count];
+						bit_count <= bit_count + 1;
+					end
 				end
 
 				PARITY_BIT: 
-				if (counter == 4'd15) begin
+				if (counter == last) begin
 					counter <= 0;
-					out <= parity_bit;
+					out <= 1'b1;  // Stop bit(s) high
+					stop_bit_count <= stop2;
 					state <= STOP_BIT;
-					stop_bit_count <= stop_bit;
 				end
 
 				STOP_BIT: 
-				if (counter == 4'd15) begin
+				if (counter == last) begin
 					counter <= 0;
-					out <= 1'b1;  // Stop bit(s) high
-					stop_bit_count <= stop_bit_count - 1;
-					if (stop_bit_count == 0) begin
-						if (!fifo_empty) begin
-							state <= START_BIT;  // Go to START_BIT if FIFO is not empty
-						end else begin
-							state <= IDLE;       // Go to IDLE if FIFO is empty
-						end
-					end else state <= STOP_BIT;
+					if (stop_bit_count) begin
+						stop_bit_count <= 1'b0;
+					end else if (!hold && (next_valid || !fifo_empty)) begin
+						// Next frame starts on the very next bit period
+						out <= 1'b0;
+						shift_reg <= next_valid ? next_data : data[7:0];
+						data_request <= !next_valid;
+						next_valid <= 1'b0;
+						state <= START_BIT;
+					end else begin
+						state <= IDLE;
+					end
+				end else if (!stop_bit_count && !next_valid && !fifo_empty) begin
+					// Preload the next entry during the last stop bit
+					next_data <= data[7:0];
+					next_valid <= 1'b1;
+					data_request <= 1'b1;
 				end
 				default: state <= IDLE; // Reset to IDLE for safety
 			endcase	
 			end
-
-		end 
 		end
 	end
 	
-    // Calculate parity based on data and parity type
+    // Calculate parity over the data bits of the frame on the line
     always_comb begin
-        case (parity)
-            2'b01: parity_bit = ^data;         // Even parity
-            2'b10: parity_bit = ~^data;        // Odd parity
-            default: parity_bit = 1'b0;        // No parity
+        case (size)
+            2'b00: parity_bit = ^shift_reg[4:0];
+            2'b01: parity_bit = ^shift_reg[5:0];
+            2'b10: parity_bit = ^shift_reg[6:0];
+            default: parity_bit = ^shift_reg[7:0];
         endcase
+        if (parity == 2'b10)
+            parity_bit = ~parity_bit;     // Odd parity
     end
-	
-	always_comb begin
-        case (stop2)
-            1'b0: stop_bit = 2'b01;         
-            1'b1: stop_bit = 2'b10;        
-            default: stop_bit = 2'b01;        
-        endcase
-    end
-
-	// Control data_request based on FSM state
-	always_comb begin
-		data_request = (state == START_BIT); // Only request new data when entering START_BIT state
-	end
 
 endmodule
 
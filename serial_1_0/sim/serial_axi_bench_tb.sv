@@ -0,0 +1,252 @@
+// AXI4-lite slave cycle benchmark
+// (serial_axi_bench_tb.sv)
+//
+// Drives back-to-back bursts into serial_v1_0_AXI with valid held high and
+// reports the clocks per transaction for each register; data register reads
+// are checked against bytes injected into the RX FIFO, so the prefetched
+// FIFO head and the pop in the read handshake are both exercised
+//
+// Run from this directory with any SystemVerilog simulator, e.g.
+//   xvlog -sv ../hdl/fifo.sv ../hdl/edge_detector.sv ../hdl/brd.sv \
+//         ../hdl/transmitter.sv ../hdl/receiver.sv ../hdl/serial_channel.sv \
+//         ../hdl/serial_v1_0_AXI.v \
+//         serial_axi_bench_tb.sv
+//   xelab -R serial_axi_bench_tb
+
+`timescale 1 ns / 1 ps
+
+module serial_axi_bench_tb();
+
+	localparam integer N = 64;
+
+	// Register byte offsets
+	localparam [5:0] DATA    = 6'd0;
+	localparam [5:0] STATUS  = 6'd4;
+	localparam [5:0] CONTROL = 6'd8;
+	localparam [5:0] LEVEL   = 6'd20;
+	localparam [5:0] PACKED  = 6'd28;
+
+	reg clk = 1'b0;
+	reg resetn = 1'b0;
+	integer cycle = 0;
+	integer errors = 0;
+
+	always #5 clk = ~clk;
+	always @(posedge clk) cycle <= cycle + 1;
+
+	reg [5:0] awaddr = 0;
+	reg awvalid = 1'b0;
+	wire awready;
+	reg [31:0] wdata = 0;
+	reg [3:0] wstrb = 4'hF;
+	reg wvalid = 1'b0;
+	wire wready;
+	wire [1:0] bresp;
+	wire bvalid;
+	reg bready = 1'b1;
+	reg [5:0] araddr = 0;
+	reg arvalid = 1'b0;
+	wire arready;
+	wire [31:0] rdata;
+	wire [1:0] rresp;
+	wire rvalid;
+	reg rready = 1'b1;
+
+	serial_v1_0_AXI #(
+		.C_S_AXI_ADDR_WIDTH(6),
+		.C_RX_FIFO_DEPTH(N),
+		.C_TX_FIFO_DEPTH(N)
+	) dut (
+		.CLK_OUT(),
+		.tx_out(),
+		.rx_in(1'b1),
+		.rts_n(),
+		.cts_n(1'b0),
+		.intr(),
+		.S_AXIS_TX_TDATA(8'b0),
+		.S_AXIS_TX_TVALID(1'b0),
+		.S_AXIS_TX_TREADY(),
+		.M_AXIS_RX_TDATA(),
+		.M_AXIS_RX_TVALID(),
+		.M_AXIS_RX_TREADY(1'b0),
+		.M_AXIS_RX_TLAST(),
+		.S_AXI_ACLK(clk),
+		.S_AXI_ARESETN(resetn),
+		.S_AXI_AWADDR(awaddr),
+		.S_AXI_AWPROT(3'b0),
+		.S_AXI_AWVALID(awvalid),
+		.S_AXI_AWREADY(awready),
+		.S_AXI_WDATA(wdata),
+		.S_AXI_WSTRB(wstrb),
+		.S_AXI_WVALID(wvalid),
+		.S_AXI_WREADY(wready),
+		.S_AXI_BRESP(bresp),
+		.S_AXI_BVALID(bvalid),
+		.S_AXI_BREADY(bready),
+		.S_AXI_ARADDR(araddr),
+		.S_AXI_ARPROT(3'b0),
+		.S_AXI_ARVALID(arvalid),
+		.S_AXI_ARREADY(arready),
+		.S_AXI_RDATA(rdata),
+		.S_AXI_RRESP(rresp),
+		.S_AXI_RVALID(rvalid),
+		.S_AXI_RREADY(rready)
+	);
+
+	// Handshakes are sampled on the falling edge (ready is combinational) and
+	// the master updates its outputs just after the rising edge
+	task automatic write_burst(input [5:0] addr, input integer n, input [31:0] first,
+	                           output integer cycles);
+		integer sent, done, start;
+		bit aw_hs, b_hs;
+		begin
+			sent = 0;
+			done = 0;
+			start = cycle;
+			awaddr = addr;
+			wdata = first;
+			awvalid = 1'b1;
+			wvalid = 1'b1;
+			while (done < n)
+			begin
+				@(negedge clk);
+				aw_hs = awvalid && awready && wready;
+				b_hs = bvalid && bready;
+				@(posedge clk);
+				#1;
+				if (aw_hs)
+				begin
+					sent = sent + 1;
+					wdata = first + sent;
+					if (sent == n)
+					begin
+						awvalid = 1'b0;
+						wvalid = 1'b0;
+					end
+				end
+				if (b_hs)
+					done = done + 1;
+			end
+			cycles = cycle - start;
+		end
+	endtask
+
+	// With check set, read data must count up from want
+	task automatic read_burst(input [5:0] addr, input integer n, input bit check,
+	                          input [31:0] want, output integer cycles);
+		integer sent, done, start;
+		bit ar_hs, r_hs;
+		reg [31:0] data;
+		begin
+			sent = 0;
+			done = 0;
+			start = cycle;
+			araddr = addr;
+			arvalid = 1'b1;
+			while (done < n)
+			begin
+				@(negedge clk);
+				ar_hs = arvalid && arready;
+				r_hs = rvalid && rready;
+				data = rdata;
+				@(posedge clk);
+				#1;
+				if (ar_hs)
+				begin
+					sent = sent + 1;
+					if (sent == n)
+						arvalid = 1'b0;
+				end
+				if (r_hs)
+				begin
+					if (check && data != want + done)
+					begin
+						$display("ERROR: read %0d from 0x%02h returned 0x%08h, expected 0x%08h",
+						         done, addr, data, want + done);
+						errors = errors + 1;
+					end
+					done = done + 1;
+				end
+			end
+			cycles = cycle - start;
+		end
+	endtask
+
+	// Push bytes into the RX FIFO as if the receiver had delivered them
+	task automatic rx_inject(input [7:0] first, input integer n);
+		integer i;
+		begin
+			for (i = 0; i < n; i = i + 1)
+			begin
+				@(negedge clk);
+				force dut.g_channel[0].channel.rx_data_out = {5'b0, first + i[7:0]};
+				force dut.g_channel[0].channel.rx_fifo_wr_request = 1'b1;
+			end
+			@(negedge clk);
+			force dut.g_channel[0].channel.rx_fifo_wr_request = 1'b0;
+			@(negedge clk);
+			release dut.g_channel[0].channel.rx_fifo_wr_request;
+			release dut.g_channel[0].channel.rx_data_out;
+		end
+	endtask
+
+	task automatic report(input string name, input integer n, input integer cycles);
+		$display("%-24s %4d transactions %5d clocks  %0.2f clocks/transaction",
+		         name, n, cycles, real'(cycles) / n);
+	endtask
+
+	task automatic expect_reg(input [5:0] addr, input [31:0] want, input [31:0] mask);
+		integer cycles;
+		begin
+			read_burst(addr, 1, 1'b0, 0, cycles);
+			if ((rdata & mask) != want)
+			begin
+				$display("ERROR: register 0x%02h = 0x%08h, expected 0x%08h (mask 0x%08h)",
+				         addr, rdata, want, mask);
+				errors = errors + 1;
+			end
+		end
+	endtask
+
+	integer cycles;
+
+	initial
+	begin
+		repeat (4) @(posedge clk);
+		#1 resetn = 1'b1;
+		repeat (2) @(posedge clk);
+		#1;
+
+		// Back-to-back register writes and reads
+		write_burst(CONTROL, N, 32'h0, cycles);
+		report("control writes", N, cycles);
+		read_burst(STATUS, N, 1'b0, 0, cycles);
+		report("status reads", N, cycles);
+
+		// Data writes fill the TX FIFO (the transmitter is disabled)
+		write_burst(CONTROL, 1, 32'h3, cycles);
+		write_burst(DATA, N, 32'h40, cycles);
+		report("data writes", N, cycles);
+		expect_reg(LEVEL, N << 16, 32'hFFFF0000);
+
+		// Data reads return the prefetched head and pop it in the same handshake
+		rx_inject(8'h80, N);
+		expect_reg(LEVEL, N, 32'h0000FFFF);
+		read_burst(DATA, N, 1'b1, 32'h80, cycles);
+		report("data reads", N, cycles);
+		expect_reg(LEVEL, 0, 32'h0000FFFF);
+
+		// Packed accesses move 4 bytes each, one FIFO entry per clock
+		rx_inject(8'h00, N);
+		read_burst(PACKED, N / 4, 1'b0, 0, cycles);
+		report("packed reads", N / 4, cycles);
+		expect_reg(LEVEL, 0, 32'h0000FFFF);
+
+		if (errors == 0)
+			$display("PASS");
+		else
+			$display("FAIL: %0d errors", errors);
+		$finish;
+	end
+
+endmodule
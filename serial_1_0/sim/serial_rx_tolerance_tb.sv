@@ -0,0 +1,199 @@
+// Receiver baud error and jitter tolerance
+// (serial_rx_tolerance_tb.sv)
+//
+// Feeds the receiver streams of back-to-back 8N1 frames from a sender whose
+// bit time is off by a swept percentage and whose every edge is displaced by
+// uniform random jitter, at each oversampling ratio. A point passes when
+// every byte arrives intact with no framing error; the table marks each
+// point as
+//   .  all bytes correct
+//   n  all bytes correct, some flagged as noisy (samples disagreed)
+//   X  bytes lost, corrupted or framed badly
+// and each row ends with the contiguous passing range around 0%
+//
+// The bit time is 64 clocks at every ratio (brd 4, 8 and 16 for 16x, 8x
+// and 4x), so the rows differ only in how finely a bit is sampled
+//
+// Run from this directory with any SystemVerilog simulator, e.g.
+//   xvlog -sv ../hdl/brd.sv ../hdl/receiver.sv serial_rx_tolerance_tb.sv
+//   xelab -R serial_rx_tolerance_tb
+
+`timescale 1 ns / 1 ps
+
+module serial_rx_tolerance_tb();
+
+	localparam real CLK_NS = 10.0;
+	localparam integer BIT_CLOCKS = 64;
+	localparam integer FRAMES = 32;
+	localparam integer ERR_STEPS = 8;          // -8% to +8% in 1% steps
+	localparam integer JITTERS = 4;            // 0, 10, 20 and 30% of a bit, peak to peak
+
+	reg clk = 1'b0;
+	reg resetn = 1'b0;
+	reg [1:0] osr = 2'b00;
+	reg [23:0] ibrd = 24'd4;
+	reg line = 1'b1;
+
+	always #(CLK_NS / 2) clk = ~clk;
+
+	wire tick;
+	wire fe, pe, ne;
+	wire [12:0] data;
+	wire data_request;
+
+	brd serial_brd (
+		.clk(clk),
+		.reset(resetn),
+		.enable(1'b1),
+		.ibrd(ibrd),
+		.fbrd(8'd0),
+		.out(tick)
+	);
+
+	receiver dut (
+		.clk(clk),
+		.reset(resetn),
+		.brgen(tick),
+		.osr(osr),
+		.enable(1'b1),
+		.size(2'b11),
+		.stop2(1'b0),
+		.parity(2'b00),
+		.fe(fe),
+		.pe(pe),
+		.ne(ne),
+		.clear_fe(1'b0),
+		.clear_pe(1'b0),
+		.clear_ne(1'b0),
+		.data(data),
+		.data_request(data_request),
+		.in(line)
+	);
+
+	// Received bytes, checked in order against what was sent
+	reg [7:0] sent [0:FRAMES-1];
+	integer received = 0, bad = 0, noisy = 0;
+	reg data_request_old = 1'b0;
+
+	always @(posedge clk)
+	begin
+		data_request_old <= data_request;
+		if (data_request && !data_request_old)
+		begin
+			if (received >= FRAMES || data[7:0] != sent[received] || data[11:9] != 3'b0)
+				bad = bad + 1;
+			if (data[12])
+				noisy = noisy + 1;
+			received = received + 1;
+		end
+	end
+
+	// Uniform in [-1, 1]
+	function automatic real spread();
+		spread = ($urandom % 2001) / 1000.0 - 1.0;
+	endfunction
+
+	// Edges land at absolute times (nominal bit k at k * bit_ns) plus their
+	// own jitter, so jitter does not accumulate along the stream
+	task automatic send_stream(input real bit_ns, input real jitter);
+		integer f, i, k;
+		reg [9:0] frame;
+		real t0, target;
+		begin
+			t0 = $realtime;
+			k = 0;
+			for (f = 0; f < FRAMES; f = f + 1)
+			begin
+				frame = {1'b1, sent[f], 1'b0};
+				for (i = 0; i < 10; i = i + 1)
+				begin
+					target = t0 + k * bit_ns + spread() * jitter * bit_ns / 2.0;
+					if (target > $realtime)
+						#(target - $realtime);
+					line = frame[i];
+					k = k + 1;
+				end
+			end
+			#(bit_ns);
+			line = 1'b1;
+		end
+	endtask
+
+	// One sweep point: returns 0 on a failure, 1 on a clean pass and 2 on a
+	// pass with noise flags
+	task automatic run_point(input integer err_pct, input integer jitter_pct, output integer result);
+		integer f;
+		begin
+			resetn = 1'b0;
+			repeat (4) @(posedge clk);
+			#1 resetn = 1'b1;
+			received = 0;
+			bad = 0;
+			noisy = 0;
+			for (f = 0; f < FRAMES; f = f + 1)
+				sent[f] = $urandom;
+			repeat (2 * BIT_CLOCKS) @(posedge clk);
+
+			send_stream(BIT_CLOCKS * CLK_NS * (100 + err_pct) / 100.0, jitter_pct / 100.0);
+			repeat (20 * BIT_CLOCKS) @(posedge clk);
+
+			if (bad != 0 || received != FRAMES)
+				result = 0;
+			else if (noisy != 0)
+				result = 2;
+			else
+				result = 1;
+		end
+	endtask
+
+	integer o, j, e, result, low, high, failures;
+	reg [8*(2*ERR_STEPS+1)-1:0] row;
+	reg [2*ERR_STEPS:0] pass;
+
+	initial
+	begin
+		failures = 0;
+		$display("baud error %%       -8      0      +8");
+		for (o = 0; o < 3; o = o + 1)
+		begin
+			osr = o;
+			ibrd = BIT_CLOCKS / (16 >> o);
+			for (j = 0; j < JITTERS; j = j + 1)
+			begin
+				for (e = -ERR_STEPS; e <= ERR_STEPS; e = e + 1)
+				begin
+					run_point(e, j * 10, result);
+					pass[e + ERR_STEPS] = (result != 0);
+					row[8*(ERR_STEPS - e) +: 8] = (result == 0) ? "X" : (result == 2) ? "n" : ".";
+				end
+
+				// Contiguous passing range around 0%
+				low = 0;
+				high = 0;
+				if (pass[ERR_STEPS])
+				begin
+					while (low > -ERR_STEPS && pass[low - 1 + ERR_STEPS])
+						low = low - 1;
+					while (high < ERR_STEPS && pass[high + 1 + ERR_STEPS])
+						high = high + 1;
+				end
+				else
+					failures = failures + 1;
+				if (j == 0 && (low > -2 || high < 2))
+					failures = failures + 1;
+
+				$display("%2dx jitter %2d%%     %s   %0d%% to +%0d%%",
+				         16 >> o, j * 10, row, low, high);
+			end
+		end
+
+		// Without jitter every ratio must hold at least +/-2%, the usual
+		// budget for two ends each within 1% of nominal
+		if (failures == 0)
+			$display("PASS");
+		else
+			$display("FAIL: %0d rows below the +/-2%% budget", failures);
+		$finish;
+	end
+
+endmodule
@@ -0,0 +1,232 @@
+// Transmitter line utilization
+// (serial_tx_utilization_tb.sv)
+//
+// Sends bursts of frames through the TX FIFO and transmitter and measures
+// how busy the line stays: utilization is the time the frames need at the
+// configured rate over the time from the first start bit to the end of
+// the last stop bit, so any dead time between frames shows up below 100%.
+// Each burst runs once with the FIFO filled up front and once with a
+// writer that refills the empty FIFO after a random delay of up to half a
+// frame; a receiver on the line checks every byte
+//
+// Run from this directory with any SystemVerilog simulator, e.g.
+//   xvlog -sv ../hdl/fifo.sv ../hdl/brd.sv ../hdl/transmitter.sv \
+//         ../hdl/receiver.sv serial_tx_utilization_tb.sv
+//   xelab -R serial_tx_utilization_tb
+
+`timescale 1 ns / 1 ps
+
+module serial_tx_utilization_tb();
+
+	localparam integer N = 48;
+
+	reg clk = 1'b0;
+	reg resetn = 1'b0;
+	reg enable = 1'b0;
+	integer cycle = 0;
+	integer errors = 0;
+
+	always #5 clk = ~clk;
+	always @(posedge clk) cycle <= cycle + 1;
+
+	// Line settings
+	reg [1:0] osr = 2'b00;
+	reg [23:0] ibrd = 24'd4;
+	reg [1:0] size = 2'b11;
+	reg [1:0] parity = 2'b00;
+	reg stop2 = 1'b0;
+
+	reg [8:0] wr_data = 9'b0;
+	reg wr_request = 1'b0;
+	wire [8:0] fifo_head;
+	wire fifo_empty, fifo_full, pop;
+	wire [6:0] wr_index, rd_index, level;
+	wire tick, line;
+	wire [12:0] rx_data;
+	wire rx_request;
+
+	fifo #(
+		.ADDR_WIDTH(6),
+		.WIDTH(9)
+	) tx_fifo (
+		.clk(clk),
+		.reset(resetn),
+		.wr_data(wr_data),
+		.wr_request(wr_request),
+		.rd_data(fifo_head),
+		.rd_request(pop),
+		.empty(fifo_empty),
+		.full(fifo_full),
+		.overflow(),
+		.clear_overflow_request(1'b0),
+		.wr_index(wr_index),
+		.rd_index(rd_index),
+		.watermark(level)
+	);
+
+	brd serial_brd (
+		.clk(clk),
+		.reset(resetn),
+		.enable(enable),
+		.ibrd(ibrd),
+		.fbrd(8'd0),
+		.out(tick)
+	);
+
+	transmitter tx (
+		.clk(clk),
+		.reset(resetn),
+		.brgen(tick),
+		.osr(osr),
+		.enable(enable),
+		.size(size),
+		.stop2(stop2),
+		.parity(parity),
+		.fifo_empty(fifo_empty),
+		.hold(1'b0),
+		.data(fifo_head),
+		.data_request(pop),
+		.out(line)
+	);
+
+	receiver rx (
+		.clk(clk),
+		.reset(resetn),
+		.brgen(tick),
+		.osr(osr),
+		.enable(enable),
+		.size(size),
+		.stop2(stop2),
+		.parity(parity),
+		.fe(),
+		.pe(),
+		.ne(),
+		.clear_fe(1'b0),
+		.clear_pe(1'b0),
+		.clear_ne(1'b0),
+		.data(rx_data),
+		.data_request(rx_request),
+		.in(line)
+	);
+
+	// Received bytes, checked in order against what was sent
+	reg [7:0] sent [0:N-1];
+	integer received = 0, bad = 0;
+	reg rx_request_old = 1'b0;
+	wire [7:0] mask = 8'hFF >> (2'd3 - size);
+
+	always @(posedge clk)
+	begin
+		rx_request_old <= rx_request;
+		if (rx_request && !rx_request_old)
+		begin
+			if (received >= N || ((rx_data[7:0] ^ sent[received]) & mask) != 0 || rx_data[11:9] != 3'b0)
+				bad = bad + 1;
+			received = received + 1;
+		end
+	end
+
+	// First start bit and last return to idle, both sampled one clock late
+	integer first_edge = -1, last_idle = -1;
+	reg line_old = 1'b1;
+	reg [2:0] state_old = 3'b0;
+
+	always @(posedge clk)
+	begin
+		line_old <= line;
+		state_old <= tx.state;
+		if (first_edge < 0 && line_old && !line)
+			first_edge = cycle;
+		if (state_old == tx.STOP_BIT && tx.state == tx.IDLE)
+			last_idle = cycle;
+	end
+
+	task automatic push(input [7:0] byte_in);
+		begin
+			@(negedge clk);
+			wr_data = {1'b0, byte_in};
+			wr_request = 1'b1;
+			@(negedge clk);
+			wr_request = 1'b0;
+		end
+	endtask
+
+	task automatic run(input string name, input bit trickle);
+		integer i, bits, bit_clocks, expected, elapsed;
+		begin
+			enable = 1'b0;
+			resetn = 1'b0;
+			repeat (4) @(posedge clk);
+			#1 resetn = 1'b1;
+			received = 0;
+			bad = 0;
+			first_edge = -1;
+			last_idle = -1;
+			for (i = 0; i < N; i = i + 1)
+				sent[i] = $urandom;
+
+			bits = 1 + size + 5 + (parity != 2'b00) + 1 + stop2;
+			bit_clocks = (16 >> osr) * ibrd;
+			expected = N * bits * bit_clocks;
+
+			if (!trickle)
+			begin
+				for (i = 0; i < N; i = i + 1)
+					push(sent[i]);
+				enable = 1'b1;
+			end
+			else
+			begin
+				enable = 1'b1;
+				for (i = 0; i < N; i = i + 1)
+				begin
+					wait (fifo_empty);
+					if (i > 0)
+						repeat ($urandom % (bits * bit_clocks / 2)) @(posedge clk);
+					push(sent[i]);
+				end
+			end
+			wait (received == N);
+			repeat (4 * bit_clocks) @(posedge clk);
+
+			elapsed = last_idle - first_edge;
+			if (bad != 0 || received != N || elapsed != expected)
+				errors = errors + 1;
+			$display("%-12s %-3dx brd %-3d %0d%s%0d %8d %8d  %6.2f%%  %0d/%0d bytes ok",
+			         name, 16 >> osr, ibrd, size + 5,
+			         parity == 2'b00 ? "N" : parity == 2'b01 ? "E" : "O", stop2 + 1,
+			         expected, elapsed, 100.0 * expected / elapsed, received - bad, N);
+		end
+	endtask
+
+	integer c, f;
+
+	initial
+	begin
+		$display("burst        ratio  brd format  needed  elapsed  utilization");
+		for (c = 0; c < 4; c = c + 1)
+		begin
+			// 64-clock bits at each ratio, then 4x at the fastest divisor
+			osr = (c == 3) ? 2'b10 : c;
+			ibrd = (c == 3) ? 24'd1 : 64 / (16 >> c);
+			for (f = 0; f < 4; f = f + 1)
+			begin
+				case (f)
+					0: begin size = 2'b11; parity = 2'b00; stop2 = 1'b0; end
+					1: begin size = 2'b00; parity = 2'b00; stop2 = 1'b0; end
+					2: begin size = 2'b10; parity = 2'b01; stop2 = 1'b0; end
+					3: begin size = 2'b11; parity = 2'b10; stop2 = 1'b1; end
+				endcase
+				run("prefilled", 1'b0);
+				run("trickle", 1'b1);
+			end
+		end
+
+		if (errors == 0)
+			$display("PASS");
+		else
+			$display("FAIL: %0d bursts below 100%% or with bad bytes", errors);
+		$finish;
+	end
+
+endmodule
@@ -7,6 +7,10 @@ proc init_gui { IPINST } {
   ipgui::add_param $IPINST -name "C_AXI_ADDR_WIDTH" -parent ${Page_0}
   ipgui::add_param $IPINST -name "C_AXI_BASEADDR" -parent ${Page_0}
   ipgui::add_param $IPINST -name "C_AXI_HIGHADDR" -parent ${Page_0}
+  ipgui::add_param $IPINST -name "C_RX_FIFO_DEPTH" -parent ${Page_0} -widget comboBox
+  ipgui::add_param $IPINST -name "C_TX_FIFO_DEPTH" -parent ${Page_0} -widget comboBox
+  ipgui::add_param $IPINST -name "C_CLK_MHZ" -parent ${Page_0}
+  ipgui::add_param $IPINST -name "C_NUM_CHANNELS" -parent ${Page_0}
 
 
 }
@@ -20,8 +24,15 @@ proc validate_PARAM_VALUE.C_AXI_DATA_WIDTH { PARAM_VALUE.C_AXI_DATA_WIDTH } {
 	return true
 }
 
-proc update_PARAM_VALUE.C_AXI_ADDR_WIDTH { PARAM_VALUE.C_AXI_ADDR_WIDTH } {
+proc update_PARAM_VALUE.C_AXI_ADDR_WIDTH { PARAM_VALUE.C_AXI_ADDR_WIDTH PARAM_VALUE.C_NUM_CHANNELS } {
 	# Procedure called to update C_AXI_ADDR_WIDTH when any of the dependent parameters in the arguments change
+	# 64 bytes per channel
+	set channels [get_property value ${PARAM_VALUE.C_NUM_CHANNELS}]
+	set width 6
+	while {(1 << ($width - 6)) < $channels} {
+		incr width
+	}
+	set_property value $width ${PARAM_VALUE.C_AXI_ADDR_WIDTH}
 }
 
 proc validate_PARAM_VALUE.C_AXI_ADDR_WIDTH { PARAM_VALUE.C_AXI_ADDR_WIDTH } {
@@ -38,6 +49,44 @@ proc validate_PARAM_VALUE.C_AXI_BASEADDR { PARAM_VALUE.C_AXI_BASEADDR } {
 	return true
 }
 
+proc update_PARAM_VALUE.C_RX_FIFO_DEPTH { PARAM_VALUE.C_RX_FIFO_DEPTH } {
+	# Procedure called to update C_RX_FIFO_DEPTH when any of the dependent parameters in the arguments change
+}
+
+proc validate_PARAM_VALUE.C_RX_FIFO_DEPTH { PARAM_VALUE.C_RX_FIFO_DEPTH } {
+	# Procedure called to validate C_RX_FIFO_DEPTH
+	return true
+}
+
+proc update_PARAM_VALUE.C_TX_FIFO_DEPTH { PARAM_VALUE.C_TX_FIFO_DEPTH } {
+	# Procedure called to update C_TX_FIFO_DEPTH when any of the dependent parameters in the arguments change
+}
+
+proc validate_PARAM_VALUE.C_TX_FIFO_DEPTH { PARAM_VALUE.C_TX_FIFO_DEPTH } {
+	# Procedure called to validate C_TX_FIFO_DEPTH
+	return true
+}
+
+proc update_PARAM_VALUE.C_CLK_MHZ { PARAM_VALUE.C_CLK_MHZ } {
+	# Procedure called to update C_CLK_MHZ when any of the dependent parameters in the arguments change
+}
+
+proc validate_PARAM_VALUE.C_CLK_MHZ { PARAM_VALUE.C_CLK_MHZ } {
+	# Procedure called to validate C_CLK_MHZ
+	set mhz [get_property value ${PARAM_VALUE.C_CLK_MHZ}]
+	return [expr {$mhz >= 10 && $mhz <= 250}]
+}
+
+proc update_PARAM_VALUE.C_NUM_CHANNELS { PARAM_VALUE.C_NUM_CHANNELS } {
+	# Procedure called to update C_NUM_CHANNELS when any of the dependent parameters in the arguments change
+}
+
+proc validate_PARAM_VALUE.C_NUM_CHANNELS { PARAM_VALUE.C_NUM_CHANNELS } {
+	# Procedure called to validate C_NUM_CHANNELS
+	set channels [get_property value ${PARAM_VALUE.C_NUM_CHANNELS}]
+	return [expr {$channels >= 1 && $channels <= 16}]
+}
+
 proc update_PARAM_VALUE.C_AXI_HIGHADDR { PARAM_VALUE.C_AXI_HIGHADDR } {
 	# Procedure called to update C_AXI_HIGHADDR when any of the dependent parameters in the arguments change
 }
@@ -58,3 +107,23 @@ proc update_MODELPARAM_VALUE.C_AXI_ADDR_WIDTH { MODELPARAM_VALUE.C_AXI_ADDR_WIDT
 	set_property value [get_property value ${PARAM_VALUE.C_AXI_ADDR_WIDTH}] ${MODELPARAM_VALUE.C_AXI_ADDR_WIDTH}
 }
 
+proc update_MODELPARAM_VALUE.C_RX_FIFO_DEPTH { MODELPARAM_VALUE.C_RX_FIFO_DEPTH PARAM_VALUE.C_RX_FIFO_DEPTH } {
+	# Procedure called to set VHDL generic/Verilog parameter value(s) based on TCL parameter value
+	set_property value [get_property value ${PARAM_VALUE.C_RX_FIFO_DEPTH}] ${MODELPARAM_VALUE.C_RX_FIFO_DEPTH}
+}
+
+proc update_MODELPARAM_VALUE.C_TX_FIFO_DEPTH { MODELPARAM_VALUE.C_TX_FIFO_DEPTH PARAM_VALUE.C_TX_FIFO_DEPTH } {
+	# Procedure called to set VHDL generic/Verilog parameter value(s) based on TCL parameter value
+	set_property value [get_property value ${PARAM_VALUE.C_TX_FIFO_DEPTH}] ${MODELPARAM_VALUE.C_TX_FIFO_DEPTH}
+}
+
+proc update_MODELPARAM_VALUE.C_CLK_MHZ { MODELPARAM_VALUE.C_CLK_MHZ PARAM_VALUE.C_CLK_MHZ } {
+	# Procedure called to set VHDL generic/Verilog parameter value(s) based on TCL parameter value
+	set_property value [get_property value ${PARAM_VALUE.C_CLK_MHZ}] ${MODELPARAM_VALUE.C_CLK_MHZ}
+}
+
+proc update_MODELPARAM_VALUE.C_NUM_CHANNELS { MODELPARAM_VALUE.C_NUM_CHANNELS PARAM_VALUE.C_NUM_CHANNELS } {
+	# Procedure called to set VHDL generic/Verilog parameter value(s) based on TCL parameter value
+	set_property value [get_property value ${PARAM_VALUE.C_NUM_CHANNELS}] ${MODELPARAM_VALUE.C_NUM_CHANNELS}
+}
+
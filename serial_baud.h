@@ -0,0 +1,82 @@
+// Serial IP Baud Rate Divisor
+// Olajumoke Aboderin
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Xilinx XUP Blackboard
+
+// Integer divisor math shared by the kernel drivers and user space
+//
+// The baud rate generator ticks every brd / 256 clocks (brd is the BRD
+// register, 24.8 fixed point) and each bit takes 16, 8 or 4 ticks
+// (control[14:13]), so
+//   baud = CLK_FREQ * 256 / (brd * ticks per bit)
+// serial_baud_divisor() tries each ratio and keeps the one whose rounded
+// divisor lands closest to the requested rate, preferring more ticks per
+// bit on a tie since the receiver then samples closer to mid-bit
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef SERIAL_BAUD_H_
+#define SERIAL_BAUD_H_
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/math64.h>
+#define SERIAL_BAUD_DIV(n, d) div64_u64(n, d)
+#else
+#include <stdint.h>
+#define SERIAL_BAUD_DIV(n, d) ((n) / (d))
+#endif
+
+#include "serial_regs.h"
+
+// Smallest divisor the generator supports (1.0 clocks per tick)
+#define SERIAL_BRD_MIN 0x100
+#define SERIAL_BRD_MAX 0xFFFFFFFF
+
+// Baud rate produced by a divisor and oversampling field
+static inline uint32_t serial_baud_rate(uint32_t clk, uint32_t brd, uint32_t osr) {
+	uint64_t den;
+
+	if (osr > OSR_4X)
+		osr = OSR_4X;
+	den = (uint64_t)brd * OSR_TICKS(osr);
+	if (den == 0)
+		return 0;
+	return (uint32_t)SERIAL_BAUD_DIV((uint64_t)clk * 256 + den / 2, den);
+}
+
+// Divisor and oversampling field for the rate closest to baud; returns
+// that rate, or 0 when baud is out of range for every ratio
+static inline uint32_t serial_baud_divisor(uint32_t clk, uint32_t baud,
+                                           uint32_t *brd, uint32_t *osr) {
+	uint32_t best = 0, best_err = 0xFFFFFFFF;
+	uint32_t field;
+
+	if (baud == 0)
+		return 0;
+	for (field = OSR_16X; field <= OSR_4X; field++) {
+		uint64_t den = (uint64_t)baud * OSR_TICKS(field);
+		uint64_t div = SERIAL_BAUD_DIV((uint64_t)clk * 256 + den / 2, den);
+		uint32_t actual, err;
+
+		if (div < SERIAL_BRD_MIN || div > SERIAL_BRD_MAX)
+			continue;
+		actual = serial_baud_rate(clk, (uint32_t)div, field);
+		err = actual > baud ? actual - baud : baud - actual;
+		if (err < best_err) {
+			best_err = err;
+			best = actual;
+			*brd = (uint32_t)div;
+			*osr = field;
+		}
+	}
+	return best;
+}
+
+#endif
@@ -0,0 +1,447 @@
+// Serial IP Loopback Benchmark
+// Olajumoke Aboderin
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Xilinx XUP Blackboard
+
+// Hardware configuration:
+//
+// AXI4-Lite interface:
+//  Mapped to offset of 0x20000
+
+// Sweeps baud rate, word size, parity and stop bits with the IP in internal
+// loopback (control[12]) and measures, for each line setting:
+//   - sustained throughput of an n byte transfer against the line rate
+//   - per-byte round-trip latency (write one byte, wait for it to return)
+//   - framing/parity errors, FIFO overflows, and bytes lost or corrupted
+// Results are printed as CSV on stdout, one row per setting
+//
+// Two data paths:
+//   default   user space through /dev/mem with libserialip
+//   -t dev    the kernel TTY driver (e.g. /dev/ttyserial0); the line is
+//             still configured and put in loopback through the register
+//             map, and the error counts come from /proc/tty/driver/ttyserial
+//
+// Build:
+//   gcc -O2 serial_bench.c serialip.c -o serial_bench
+// Example:
+//   ./serial_bench -b 115200,460800,921600 -p 0,1,2 -s 1,2 > results.csv
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "../address_map.h"
+#include "serialip.h"
+
+#define MAX_LIST        16
+#define DEFAULT_BYTES   16384
+#define DEFAULT_SAMPLES 100
+#define PROC_TTY        "/proc/tty/driver/ttyserial"
+
+// Line setting under test
+typedef struct {
+	uint32_t baud;
+	uint8_t bits;
+	uint8_t parity;
+	uint8_t stop;
+} lineConfig;
+
+// Error counters
+typedef struct {
+	uint64_t frame;
+	uint64_t parity;
+	uint64_t rx_overflow;
+	uint64_t tx_overflow;
+} errorCounts;
+
+// Data path: non-blocking transfers plus a wait for RX data
+typedef struct {
+	const char *name;
+	size_t (*write)(const uint8_t *buf, size_t len);
+	size_t (*read)(uint8_t *buf, size_t len);
+	bool (*waitRx)(double timeout);
+	void (*errors)(errorCounts *counts);
+} benchPath;
+
+serial_dev_t *dev = NULL;
+int tty = -1;
+unsigned int ttyLine = 0;
+errorCounts sticky;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Count and clear the sticky status flags; the mmap path calls this on
+// every pass, so each flag counts once per pass it was seen in
+static void pollSticky(void) {
+	uint32_t status = serial_status(dev);
+	uint32_t flags = status & (FRAME_ERR | PARITY_ERR | RXOV | TXOV);
+
+	if (!flags)
+		return;
+	if (flags & FRAME_ERR)
+		sticky.frame++;
+	if (flags & PARITY_ERR)
+		sticky.parity++;
+	if (flags & RXOV)
+		sticky.rx_overflow++;
+	if (flags & TXOV)
+		sticky.tx_overflow++;
+	serial_clear_status(dev, flags);
+}
+
+// User-space path
+static size_t mmapWrite(const uint8_t *buf, size_t len) {
+	size_t n = serial_write_buf(dev, buf, len);
+	pollSticky();
+	return n;
+}
+
+static size_t mmapRead(uint8_t *buf, size_t len) {
+	return serial_read_buf(dev, buf, len);
+}
+
+static bool mmapWaitRx(double timeout) {
+	double end = now() + timeout;
+
+	while (serial_status(dev) & RXFE)
+		if (now() > end)
+			return false;
+	return true;
+}
+
+static void mmapErrors(errorCounts *counts) {
+	pollSticky();
+	*counts = sticky;
+}
+
+// Kernel TTY path
+static size_t ttyWrite(const uint8_t *buf, size_t len) {
+	ssize_t n = write(tty, buf, len);
+	return n > 0 ? (size_t)n : 0;
+}
+
+static size_t ttyRead(uint8_t *buf, size_t len) {
+	ssize_t n = read(tty, buf, len);
+	return n > 0 ? (size_t)n : 0;
+}
+
+static bool ttyWaitRx(double timeout) {
+	struct pollfd pfd = { .fd = tty, .events = POLLIN };
+	return poll(&pfd, 1, (int)(timeout * 1000) + 1) > 0;
+}
+
+// The driver counts and clears the sticky flags itself; read its totals
+// from the /proc line of the port under test
+static void ttyErrors(errorCounts *counts) {
+	unsigned long long fe = 0, pe = 0, oe = 0;
+	char line[512];
+	FILE *file = fopen(PROC_TTY, "r");
+
+	memset(counts, 0, sizeof(*counts));
+	if (!file)
+		return;
+	while (fgets(line, sizeof(line), file)) {
+		char *p;
+		if (strtoul(line, &p, 10) != ttyLine || *p != ':')
+			continue;
+		if ((p = strstr(line, " fe:")))
+			fe = strtoull(p + 4, NULL, 10);
+		if ((p = strstr(line, " pe:")))
+			pe = strtoull(p + 4, NULL, 10);
+		if ((p = strstr(line, " oe:")))
+			oe = strtoull(p + 4, NULL, 10);
+	}
+	fclose(file);
+	counts->frame = fe;
+	counts->parity = pe;
+	counts->rx_overflow = oe;
+}
+
+static const benchPath mmapPath = { "mmap", mmapWrite, mmapRead, mmapWaitRx, mmapErrors };
+static const benchPath ttyPath = { "tty", ttyWrite, ttyRead, ttyWaitRx, ttyErrors };
+
+// Bits on the line per character
+static unsigned int frameBits(const lineConfig *cfg) {
+	return 1 + cfg->bits + (cfg->parity ? 1 : 0) + cfg->stop;
+}
+
+// Program the line, turn on loopback and drop anything left over
+// Returns the baud rate the divisor reached, 0 when it is out of range
+static uint32_t applyConfig(const benchPath *path, const lineConfig *cfg) {
+	uint8_t junk[256];
+	uint32_t actual;
+
+	serial_enable(dev, false);
+	actual = serial_set_baud(dev, cfg->baud);
+	serial_set_data_length(dev, cfg->bits);
+	serial_set_parity(dev, cfg->parity);
+	serial_set_stop_bits(dev, cfg->stop);
+	serial_set_loopback(dev, true);
+	serial_enable(dev, true);
+
+	while (path->waitRx(0.01))
+		path->read(junk, sizeof(junk));
+	serial_clear_status(dev, FRAME_ERR | PARITY_ERR | RXOV | TXOV);
+	return actual;
+}
+
+// Send n bytes and read them back as fast as the path allows; gives up
+// once nothing has arrived for a full RX FIFO's worth of character times
+static double runThroughput(const benchPath *path, const lineConfig *cfg, size_t n,
+                            uint64_t *mismatches, uint64_t *lost) {
+	uint8_t *tx = malloc(n), *rx = malloc(n);
+	uint8_t mask = (1u << cfg->bits) - 1;
+	double char_time = (double)frameBits(cfg) / cfg->baud;
+	double idle = char_time * (serial_rx_depth(dev) + serial_tx_depth(dev)) + 0.1;
+	double start, last;
+	size_t sent = 0, received = 0, i;
+
+	if (!tx || !rx) {
+		free(tx);
+		free(rx);
+		*lost = n;
+		return 0;
+	}
+	for (i = 0; i < n; i++)
+		tx[i] = (i * 7 + 3) & mask;
+
+	start = last = now();
+	while (received < n) {
+		size_t got;
+
+		if (sent < n)
+			sent += path->write(tx + sent, n - sent);
+		got = path->read(rx + received, n - received);
+		received += got;
+		if (got)
+			last = now();
+		else if (now() - last > idle)
+			break;
+	}
+	last = now();
+
+	*mismatches = 0;
+	for (i = 0; i < received; i++)
+		if ((rx[i] & mask) != tx[i])
+			(*mismatches)++;
+	*lost = n - received;
+
+	free(tx);
+	free(rx);
+	return last - start;
+}
+
+static int compareDouble(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// One byte at a time: write, wait for it to come back, read it
+// Fills lat[0..3] with min, average, p99 and max in microseconds
+static void runLatency(const benchPath *path, const lineConfig *cfg, unsigned int samples,
+                       double lat[4], uint64_t *lost) {
+	double *t = malloc(samples * sizeof(*t));
+	double timeout = 100.0 * frameBits(cfg) / cfg->baud + 0.05;
+	double sum = 0;
+	unsigned int i, done = 0;
+	uint8_t byte;
+
+	memset(lat, 0, 4 * sizeof(*lat));
+	if (!t)
+		return;
+	for (i = 0; i < samples; i++) {
+		double start;
+
+		byte = i & ((1u << cfg->bits) - 1);
+		start = now();
+		if (path->write(&byte, 1) != 1 || !path->waitRx(timeout)) {
+			(*lost)++;
+			continue;
+		}
+		t[done] = (now() - start) * 1e6;
+		path->read(&byte, 1);
+		sum += t[done++];
+	}
+	if (done) {
+		qsort(t, done, sizeof(*t), compareDouble);
+		lat[0] = t[0];
+		lat[1] = sum / done;
+		lat[2] = t[(done * 99) / 100];
+		lat[3] = t[done - 1];
+	}
+	free(t);
+}
+
+static void runConfig(const benchPath *path, const lineConfig *cfg, size_t n, unsigned int samples) {
+	errorCounts before, after;
+	uint64_t mismatches = 0, lost = 0;
+	double seconds, rate, line_rate, lat[4];
+	uint32_t actual = applyConfig(path, cfg);
+
+	if (actual == 0) {
+		fprintf(stderr, "Skipping unreachable baud rate %u\n", cfg->baud);
+		return;
+	}
+	path->errors(&before);
+	seconds = runThroughput(path, cfg, n, &mismatches, &lost);
+	rate = seconds > 0 ? (n - lost) / seconds : 0;
+	runLatency(path, cfg, samples, lat, &lost);
+	path->errors(&after);
+
+	line_rate = (double)actual / frameBits(cfg);
+	printf("%s,%u,%u,%u,%u,%zu,%.6f,%.0f,%.0f,%.3f,%.1f,%.1f,%.1f,%.1f,%llu,%llu,%llu,%llu,%llu,%llu\n",
+	       path->name, cfg->baud, cfg->bits, cfg->parity, cfg->stop, n, seconds, rate,
+	       line_rate, rate / line_rate, lat[0], lat[1], lat[2], lat[3],
+	       (unsigned long long)(after.frame - before.frame),
+	       (unsigned long long)(after.parity - before.parity),
+	       (unsigned long long)(after.rx_overflow - before.rx_overflow),
+	       (unsigned long long)(after.tx_overflow - before.tx_overflow),
+	       (unsigned long long)mismatches, (unsigned long long)lost);
+	fflush(stdout);
+}
+
+// Comma separated list of numbers
+static int parseList(const char *arg, uint32_t *list) {
+	char *copy = strdup(arg), *token, *save = NULL;
+	int count = 0;
+
+	for (token = strtok_r(copy, ",", &save); token && count < MAX_LIST;
+	     token = strtok_r(NULL, ",", &save))
+		list[count++] = strtoul(token, NULL, 0);
+	free(copy);
+	return count;
+}
+
+// Raw, non-blocking TTY; line settings are made through the registers
+static int openTty(const char *path) {
+	struct termios tio;
+	int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+	if (fd < 0)
+		return -1;
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 0;
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+}
+
+static void printUsage(void) {
+	printf("Usage: ./serial_bench [options]\n");
+	printf("  -b list     baud rates (default 115200,460800,921600)\n");
+	printf("  -w list     word sizes, 5 to 8 (default 8)\n");
+	printf("  -p list     parity, 0 = none, 1 = even, 2 = odd (default 0)\n");
+	printf("  -s list     stop bits, 1 or 2 (default 1)\n");
+	printf("  -n bytes    throughput transfer size (default %d)\n", DEFAULT_BYTES);
+	printf("  -l samples  round-trip latency samples (default %d)\n", DEFAULT_SAMPLES);
+	printf("  -t device   run through the kernel TTY driver, e.g. /dev/ttyserial0\n");
+	printf("Lists are comma separated; every combination is run\n");
+	printf("CSV columns: path,baud,bits,parity,stop,bytes,seconds,bytes_per_s,\n");
+	printf("  line_bytes_per_s,efficiency,lat_min_us,lat_avg_us,lat_p99_us,lat_max_us,\n");
+	printf("  frame_errors,parity_errors,rx_overflows,tx_overflows,mismatches,lost\n");
+}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	uint32_t bauds[MAX_LIST] = { 115200, 460800, 921600 }, words[MAX_LIST] = { 8 };
+	uint32_t parities[MAX_LIST] = { 0 }, stops[MAX_LIST] = { 1 };
+	int nbauds = 3, nwords = 1, nparities = 1, nstops = 1;
+	size_t n = DEFAULT_BYTES;
+	unsigned int samples = DEFAULT_SAMPLES;
+	const char *tty_path = NULL;
+	const benchPath *path = &mmapPath;
+	uint32_t control, brd;
+	int opt, b, w, p, s;
+
+	while ((opt = getopt(argc, argv, "b:w:p:s:n:l:t:h")) != -1) {
+		switch (opt) {
+		case 'b': nbauds = parseList(optarg, bauds); break;
+		case 'w': nwords = parseList(optarg, words); break;
+		case 'p': nparities = parseList(optarg, parities); break;
+		case 's': nstops = parseList(optarg, stops); break;
+		case 'n': n = strtoul(optarg, NULL, 0); break;
+		case 'l': samples = strtoul(optarg, NULL, 0); break;
+		case 't': tty_path = optarg; break;
+		default:
+			printUsage();
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	dev = serial_open(AXI4_LITE_BASE + SERIAL_BASE_OFFSET);
+	if (!dev) {
+		fprintf(stderr, "Cannot map serial registers: %s\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if (tty_path) {
+		tty = openTty(tty_path);
+		if (tty < 0) {
+			fprintf(stderr, "Cannot open %s: %s\n", tty_path, strerror(errno));
+			serial_close(dev);
+			return EXIT_FAILURE;
+		}
+		path = &ttyPath;
+		ttyLine = strtoul(tty_path + strcspn(tty_path, "0123456789"), NULL, 10);
+	}
+
+	// Restored on exit
+	control = serial_read_reg(dev, CONTROL_REG_OFFSET);
+	brd = serial_get_brd(dev);
+
+	printf("path,baud,bits,parity,stop,bytes,seconds,bytes_per_s,line_bytes_per_s,efficiency,"
+	       "lat_min_us,lat_avg_us,lat_p99_us,lat_max_us,frame_errors,parity_errors,"
+	       "rx_overflows,tx_overflows,mismatches,lost\n");
+	for (b = 0; b < nbauds; b++)
+		for (w = 0; w < nwords; w++)
+			for (p = 0; p < nparities; p++)
+				for (s = 0; s < nstops; s++) {
+					lineConfig cfg = { bauds[b], words[w], parities[p], stops[s] };
+
+					if (cfg.baud == 0 || cfg.bits < 5 || cfg.bits > 8 ||
+					    cfg.parity > 2 || cfg.stop < 1 || cfg.stop > 2) {
+						fprintf(stderr, "Skipping invalid setting %u %u %u %u\n",
+						        cfg.baud, cfg.bits, cfg.parity, cfg.stop);
+						continue;
+					}
+					runConfig(path, &cfg, n, samples);
+				}
+
+	serial_write_reg(dev, BRD_REG_OFFSET, brd);
+	serial_write_reg(dev, CONTROL_REG_OFFSET, control);
+	if (tty >= 0)
+		close(tty);
+	serial_close(dev);
+	return EXIT_SUCCESS;
+}
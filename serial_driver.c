@@ -1,4 +1,4 @@
-// Serial IP 
+// Serial IP
 // Serial Driver (serial_driver.c)
 
 
@@ -9,23 +9,42 @@
 // Target Platform: Xilinx XUP Blackboard
 
 // Hardware configuration:
-// 
+//
 // AXI4-Lite interface
-//   Mapped to offset of 0x20000
+//   Registers and interrupt from each serial IP node's reg and interrupts
 
 
 // Load kernel module with insmod serial_driver.ko [param=___]
+// Each serial IP node in the device tree gets its own /dev/serialipN
+// (read/write/poll, ioctls in serial_ioctl.h), N counting up from 0 in
+// probe order; the debugging attributes (baud_rate, word_size, parity_mode,
+// tx_data, rx_data) are in the node's /sys/bus/platform/devices/<dev>/
 
 //-----------------------------------------------------------------------------
 #include <linux/kernel.h>     // kstrtouint
 #include <linux/module.h>     // MODULE_ macros
 #include <linux/init.h>       // __init
-#include <linux/kobject.h>    // kobject, kobject_atribute,
-                              // kobject_create_and_add, kobject_put
-#include <asm/io.h>           // iowrite, ioread, ioremap_nocache (platform specific)
+#include <asm/io.h>           // iowrite, ioread
 #include <linux/types.h>
-#include "../address_map.h"   // overall memory map
+#include <linux/interrupt.h>  // request_irq, free_irq
+#include <linux/platform_device.h>
+#include <linux/miscdevice.h> // misc_register, misc_deregister
+#include <linux/fs.h>         // file_operations
+#include <linux/poll.h>       // poll_wait, EPOLLIN, EPOLLOUT
+#include <linux/uaccess.h>    // get_user, put_user
+#include <linux/kfifo.h>      // rx/tx rings
+#include <linux/slab.h>       // kmalloc, kfree
+#include <linux/idr.h>        // instance numbers
+#include <linux/kref.h>       // instance lifetime
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/debugfs.h>
+#include <asm/unaligned.h>    // get_unaligned_le32, put_unaligned_le32
 #include "serial_regs.h"          // register offsets in QE IP
+#include "serial_ioctl.h"         // character device ioctls
+#include "serial_stats.h"         // port statistics
+#include "serial_baud.h"          // integer baud divisor
 
 
 // Kernel module information
@@ -34,138 +53,627 @@ MODULE_AUTHOR("Olajumoke Aboderin");
 MODULE_DESCRIPTION("Serial IP Driver");
 
 
+// Software RX and TX rings behind /dev/serialipN (must be a power of 2)
+#define RING_SIZE 4096
+
+// RX trigger level and RX timeout interrupts
+#define RX_INT_MASKS (INT_ON_RX_MASK | INT_ON_RX_TIMEOUT_MASK)
+
+// Per-instance state, one per serial IP node
+// The ISR fills rx_ring and read() empties it; write() fills tx_ring and
+// tx_fill() empties it into the hardware FIFO. Each ring has one producer
+// and one consumer, so kfifo needs no lock of its own; lock covers the
+// control register, tx_fill() and the flags below
+// Each open file holds a reference, so the instance (registers mapped,
+// rings and buffers) outlives remove() until the last close; remove() sets
+// dead under lock and I/O on a dead instance fails with -ENODEV
+struct serial_dev {
+    struct kref ref;
+    bool dead;
+    struct device *dev;
+    uint32_t __iomem *base;
+    unsigned int irq;
+    int id;
+    char name[16];
+    struct miscdevice misc;
+    unsigned int rx_fifo_depth;
+    unsigned int tx_fifo_depth;
+    unsigned char *rx_buf;
+    unsigned char *tx_buf;
+    DECLARE_KFIFO(rx_ring, unsigned char, RING_SIZE);
+    DECLARE_KFIFO(tx_ring, unsigned char, RING_SIZE);
+    spinlock_t lock;
+    struct mutex read_mutex;
+    struct mutex write_mutex;
+    wait_queue_head_t rx_wait;
+    wait_queue_head_t tx_wait;
+    bool rx_throttled;
+    bool tx_int_enabled;
+
+    // Port statistics in debugfs serial_driver/serialipN/stats
+    struct serial_stats stats;
+    struct dentry *stats_dir;
+};
+
 // Global variables
-static unsigned int *base = NULL;
+static DEFINE_IDA(serial_ida);
+static struct dentry *stats_root = NULL;
 
 // Subroutines
-void write_register(uint32_t offset, uint32_t value) {
-    iowrite32(value, base + offset);
+// Last reference gone: remove() has run (or probe failed) and no file
+// still has the device open
+static void serial_free(struct kref *ref) {
+    struct serial_dev *sd = container_of(ref, struct serial_dev, ref);
+
+    if (sd->base)
+        iounmap(sd->base);
+    kfree(sd->rx_buf);
+    kfree(sd->tx_buf);
+    kfree(sd);
+}
+
+static void write_register(struct serial_dev *sd, uint32_t offset, uint32_t value) {
+    iowrite32(value, sd->base + offset);
 }
 
-uint32_t read_register(uint32_t offset) {
-    return ioread32(base + offset);
+static uint32_t read_register(struct serial_dev *sd, uint32_t offset) {
+    return ioread32(sd->base + offset);
 }
 
-// kernel objects
-static ssize_t baud_rate_show(struct kobject *kobj, struct kobj_attribute *attr, char *buffer) {
-    uint32_t brd = read_register(BRD_REG_OFFSET);
-    uint32_t ibrd = brd >> 8;
-    uint32_t fbrd = brd & 0xFF;
-    float baud_rate = (float)CLK_FREQ / (16 * (ibrd + (fbrd / 256.0)));
-    return sprintf(buffer, "%.2f\n", baud_rate);
+// Program the divisor and oversampling ratio closest to baud and enable the
+// core, for both the baud_rate attribute and SERIAL_IOC_SET_BAUD; returns
+// the rate achieved, or 0 when baud is out of range
+static uint32_t set_baud(struct serial_dev *sd, uint32_t baud) {
+    unsigned long flags;
+    uint32_t brd, osr, control;
+    uint32_t actual = serial_baud_divisor(CLK_FREQ, baud, &brd, &osr);
+
+    if (actual == 0)
+        return 0;
+    spin_lock_irqsave(&sd->lock, flags);
+    write_register(sd, BRD_REG_OFFSET, brd);
+    control = read_register(sd, CONTROL_REG_OFFSET) & ~OSR_MASK;
+    write_register(sd, CONTROL_REG_OFFSET, control | (osr << OSR_OFFSET) | ENABLE_MASK);
+    spin_unlock_irqrestore(&sd->lock, flags);
+    return actual;
 }
 
-static ssize_t baud_rate_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count) {
-    float baud_rate;
-    sscanf(buffer, "%f", &baud_rate);
+static uint32_t get_baud(struct serial_dev *sd) {
+    uint32_t osr = (read_register(sd, CONTROL_REG_OFFSET) & OSR_MASK) >> OSR_OFFSET;
 
-    uint32_t divisor = CLK_FREQ / (16 * baud_rate);
-    uint32_t ibrd = divisor / 1;
-    uint32_t fbrd = (uint32_t)((divisor - ibrd) * 256);
-	
-	uint32_t control = read_register(CONTROL_REG_OFFSET);
-    write_register(BRD_REG_OFFSET, (ibrd << 8) | (fbrd & 0xFF));
-	write_register(CONTROL_REG_OFFSET, (control | ENABLE_MASK));
-	write_register(CONTROL_REG_OFFSET, (control | TEST_MASK));
+    return serial_baud_rate(CLK_FREQ, read_register(sd, BRD_REG_OFFSET), osr);
+}
+
+// Device attributes
+static ssize_t baud_rate_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    return sprintf(buffer, "%u\n", get_baud(dev_get_drvdata(dev)));
+}
+
+// Integer rates only: floating point is not available in the kernel
+static ssize_t baud_rate_store(struct device *dev, struct device_attribute *attr, const char *buffer, size_t count) {
+    struct serial_dev *sd = dev_get_drvdata(dev);
+    unsigned int baud_rate;
+
+    if (kstrtouint(buffer, 10, &baud_rate) || set_baud(sd, baud_rate) == 0)
+        return -EINVAL;
     return count;
 }
 
-static ssize_t word_size_show(struct kobject *kobj, struct kobj_attribute *attr, char *buffer) {
-    uint32_t control = read_register(CONTROL_REG_OFFSET);
+static ssize_t word_size_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    uint32_t control = read_register(dev_get_drvdata(dev), CONTROL_REG_OFFSET);
     return sprintf(buffer, "%d\n", (control & DATA_LENGTH_MASK) + 5);
 }
 
-static ssize_t word_size_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count) {
+static ssize_t word_size_store(struct device *dev, struct device_attribute *attr, const char *buffer, size_t count) {
+    struct serial_dev *sd = dev_get_drvdata(dev);
     int size;
     sscanf(buffer, "%d", &size);
 
-    uint32_t control = read_register(CONTROL_REG_OFFSET);
+    uint32_t control = read_register(sd, CONTROL_REG_OFFSET);
     control &= ~DATA_LENGTH_MASK; // Clear current setting
     control |= (size - 5);                // Set new size
-    write_register(CONTROL_REG_OFFSET, control);
+    write_register(sd, CONTROL_REG_OFFSET, control);
 
     return count;
 }
 
-static ssize_t parity_mode_show(struct kobject *kobj, struct kobj_attribute *attr, char *buffer) {
-    uint32_t control = read_register(CONTROL_REG_OFFSET);
+static ssize_t parity_mode_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    uint32_t control = read_register(dev_get_drvdata(dev), CONTROL_REG_OFFSET);
     return sprintf(buffer, "%d\n", (control & PARITY_MODE_MASK) >> 2);
 }
 
-static ssize_t parity_mode_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count) {
+static ssize_t parity_mode_store(struct device *dev, struct device_attribute *attr, const char *buffer, size_t count) {
+    struct serial_dev *sd = dev_get_drvdata(dev);
     int mode;
     sscanf(buffer, "%d", &mode);
 
-    uint32_t control = read_register(CONTROL_REG_OFFSET);
+    uint32_t control = read_register(sd, CONTROL_REG_OFFSET);
     control &= ~PARITY_MODE_MASK; // Clear current setting
     control |= (mode << 2);               // Set new mode
-    write_register(CONTROL_REG_OFFSET, control);
+    write_register(sd, CONTROL_REG_OFFSET, control);
 
     return count;
 }
 
 // Sysfs attributes for tx_data and rx_data
-static ssize_t tx_data_store(struct kobject *kobj, struct kobj_attribute *attr, const char *buffer, size_t count) {
+static ssize_t tx_data_store(struct device *dev, struct device_attribute *attr, const char *buffer, size_t count) {
     uint32_t data;
     sscanf(buffer, "%d", &data);
 
-    write_register(DATA_REG_OFFSET, data);
+    write_register(dev_get_drvdata(dev), DATA_REG_OFFSET, data);
     return count;
 }
 
-static ssize_t rx_data_show(struct kobject *kobj, struct kobj_attribute *attr, char *buffer) {
-    uint32_t status = read_register(STATUS_REG_OFFSET);
+static ssize_t rx_data_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    struct serial_dev *sd = dev_get_drvdata(dev);
+    uint32_t status = read_register(sd, STATUS_REG_OFFSET);
     if (status & 1) { // Check RX FIFO empty
         return sprintf(buffer, "-1\n"); // FIFO is empty
     }
-    uint32_t data = read_register(DATA_REG_OFFSET);
+    uint32_t data = read_register(sd, DATA_REG_OFFSET);
     return sprintf(buffer, "%d\n", data);
 }
 
 // Attribute Definitions
-static struct kobj_attribute baud_rate_attr = __ATTR(baud_rate, 0664, baud_rate_show, baud_rate_store);
-static struct kobj_attribute word_size_attr = __ATTR(word_size, 0664, word_size_show, word_size_store);
-static struct kobj_attribute parity_mode_attr = __ATTR(parity_mode, 0664, parity_mode_show, parity_mode_store);
-static struct kobj_attribute tx_data_attr = __ATTR(tx_data, 0220, NULL, tx_data_store);
-static struct kobj_attribute rx_data_attr = __ATTR(rx_data, 0444, rx_data_show, NULL);
-
-static struct attribute *attrs[] = {
-    &baud_rate_attr.attr,
-    &word_size_attr.attr,
-    &parity_mode_attr.attr,
-    &tx_data_attr.attr,
-    &rx_data_attr.attr,
+static DEVICE_ATTR_RW(baud_rate);
+static DEVICE_ATTR_RW(word_size);
+static DEVICE_ATTR_RW(parity_mode);
+static DEVICE_ATTR_WO(tx_data);
+static DEVICE_ATTR_RO(rx_data);
+
+static struct attribute *serial_attrs[] = {
+    &dev_attr_baud_rate.attr,
+    &dev_attr_word_size.attr,
+    &dev_attr_parity_mode.attr,
+    &dev_attr_tx_data.attr,
+    &dev_attr_rx_data.attr,
     NULL
 };
+ATTRIBUTE_GROUPS(serial);
+
+// Character device helpers
+
+// Read-modify-write of the control register; caller holds lock
+static void set_control(struct serial_dev *sd, uint32_t mask, uint32_t value) {
+    uint32_t control = read_register(sd, CONTROL_REG_OFFSET);
+    write_register(sd, CONTROL_REG_OFFSET, (control & ~mask) | (value & mask));
+}
+
+static void update_control(struct serial_dev *sd, uint32_t mask, uint32_t value) {
+    unsigned long flags;
+
+    spin_lock_irqsave(&sd->lock, flags);
+    set_control(sd, mask, value);
+    spin_unlock_irqrestore(&sd->lock, flags);
+}
+
+// FIFO fill levels; the status watermarks saturate at 31 entries, so
+// deeper FIFOs read the exact counts from the level register
+static unsigned int rx_level(struct serial_dev *sd, uint32_t status) {
+    if (sd->rx_fifo_depth > WATERMARK_MASK)
+        return LEVEL_RX(read_register(sd, LEVEL_REG_OFFSET));
+    return RX_WATERMARK(status);
+}
+
+static unsigned int tx_level(struct serial_dev *sd) {
+    if (sd->tx_fifo_depth > WATERMARK_MASK)
+        return LEVEL_TX(read_register(sd, LEVEL_REG_OFFSET));
+    return TX_WATERMARK(read_register(sd, STATUS_REG_OFFSET));
+}
+
+// Four bytes per bus access through the packed data register
+static void fifo_write(struct serial_dev *sd, const unsigned char *buf, unsigned int count) {
+    unsigned int i;
+
+    for (i = 0; i + 4 <= count; i += 4)
+        write_register(sd, PACKED_REG_OFFSET, get_unaligned_le32(buf + i));
+    for (; i < count; i++)
+        write_register(sd, DATA_REG_OFFSET, buf[i]);
+}
+
+static void fifo_read(struct serial_dev *sd, unsigned char *buf, unsigned int count) {
+    unsigned int i;
+
+    for (i = 0; i + 4 <= count; i += 4)
+        put_unaligned_le32(read_register(sd, PACKED_REG_OFFSET), buf + i);
+    for (; i < count; i++)
+        buf[i] = read_register(sd, DATA_REG_OFFSET);
+}
+
+// Move the TX ring into the free slots of the hardware FIFO and keep the
+// TX empty interrupt on while the ring still has data; caller holds lock
+static void tx_fill(struct serial_dev *sd) {
+    unsigned int room, count;
+    bool pending;
+
+    if (!kfifo_is_empty(&sd->tx_ring)) {
+        room = sd->tx_fifo_depth - tx_level(sd);
+        count = kfifo_out(&sd->tx_ring, sd->tx_buf, room);
+        fifo_write(sd, sd->tx_buf, count);
+        sd->stats.tx_bytes += count;
+    }
+
+    pending = !kfifo_is_empty(&sd->tx_ring);
+    if (pending != sd->tx_int_enabled) {
+        set_control(sd, INT_ON_TX_MASK, pending ? INT_ON_TX_MASK : 0);
+        sd->tx_int_enabled = pending;
+    }
+}
+
+// Drain the RX FIFO in bursts sized from one status read; once the ring is
+// full the RX interrupts are masked and the rest waits in the hardware FIFO
+// until read() makes room
+static irqreturn_t serial_isr(int irq, void *dev_id) {
+    struct serial_dev *sd = dev_id;
+    uint32_t status = read_register(sd, STATUS_REG_OFFSET);
+    irqreturn_t ret = IRQ_NONE;
+    unsigned int count, total = 0;
+    uint32_t sticky;
+
+    // Count and clear overflow and line errors (write 1 to clear)
+    sticky = serial_stats_status(&sd->stats, status);
+    if (sticky) {
+        write_register(sd, STATUS_REG_OFFSET, sticky);
+        ret = IRQ_HANDLED;
+    }
+
+    spin_lock(&sd->lock);
+    while ((count = min3(rx_level(sd, status), kfifo_avail(&sd->rx_ring), sd->rx_fifo_depth)) != 0) {
+        fifo_read(sd, sd->rx_buf, count);
+        kfifo_in(&sd->rx_ring, sd->rx_buf, count);
+        total += count;
+        status = read_register(sd, STATUS_REG_OFFSET);
+    }
+    serial_stats_irq(&sd->stats, total);
+    if (total)
+        ret = IRQ_HANDLED;
+    if (!(status & RXFE) && kfifo_is_full(&sd->rx_ring) && !sd->rx_throttled) {
+        set_control(sd, RX_INT_MASKS, 0);
+        sd->rx_throttled = true;
+        ret = IRQ_HANDLED;
+    }
+
+    if ((status & TXFE) && sd->tx_int_enabled) {
+        tx_fill(sd);
+        ret = IRQ_HANDLED;
+    }
+    spin_unlock(&sd->lock);
+
+    if (total)
+        wake_up_interruptible(&sd->rx_wait);
+    if (!kfifo_is_full(&sd->tx_ring))
+        wake_up_interruptible(&sd->tx_wait);
+    return ret;
+}
+
+// Character device file operations
+// misc_open() leaves the miscdevice in private_data
+static struct serial_dev *file_to_serial(struct file *file) {
+    return container_of(file->private_data, struct serial_dev, misc);
+}
+
+// misc_open() calls this under the misc lock, so misc_deregister() in
+// remove() cannot run between the lookup and taking the reference
+static int serial_open(struct inode *inode, struct file *file) {
+    kref_get(&file_to_serial(file)->ref);
+    return stream_open(inode, file);
+}
+
+static int serial_release(struct inode *inode, struct file *file) {
+    kref_put(&file_to_serial(file)->ref, serial_free);
+    return 0;
+}
+
+static ssize_t serial_read(struct file *file, char __user *buffer, size_t count, loff_t *offset) {
+    struct serial_dev *sd = file_to_serial(file);
+    unsigned long flags;
+    unsigned int copied;
+    int result;
+
+    if (count == 0)
+        return 0;
+
+    if (mutex_lock_interruptible(&sd->read_mutex))
+        return -ERESTARTSYS;
+    while (kfifo_is_empty(&sd->rx_ring) && !READ_ONCE(sd->dead)) {
+        mutex_unlock(&sd->read_mutex);
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(sd->rx_wait, !kfifo_is_empty(&sd->rx_ring) || READ_ONCE(sd->dead)))
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&sd->read_mutex))
+            return -ERESTARTSYS;
+    }
+    if (READ_ONCE(sd->dead)) {
+        mutex_unlock(&sd->read_mutex);
+        return -ENODEV;
+    }
+    result = kfifo_to_user(&sd->rx_ring, buffer, count, &copied);
+    mutex_unlock(&sd->read_mutex);
+
+    // The ring has room again: let the ISR pull in what queued up meanwhile
+    // (remove() clears rx_throttled, so this never touches a dead instance)
+    spin_lock_irqsave(&sd->lock, flags);
+    if (sd->rx_throttled && copied) {
+        set_control(sd, RX_INT_MASKS, RX_INT_MASKS);
+        sd->rx_throttled = false;
+    }
+    spin_unlock_irqrestore(&sd->lock, flags);
+
+    return copied ? copied : result;
+}
+
+// Queue as much of the buffer as fits and start transmission; blocks only
+// while the ring is completely full
+static ssize_t serial_write(struct file *file, const char __user *buffer, size_t count, loff_t *offset) {
+    struct serial_dev *sd = file_to_serial(file);
+    unsigned long flags;
+    unsigned int copied;
+    int result;
+
+    if (count == 0)
+        return 0;
+
+    if (mutex_lock_interruptible(&sd->write_mutex))
+        return -ERESTARTSYS;
+    while (kfifo_is_full(&sd->tx_ring) && !READ_ONCE(sd->dead)) {
+        // Writers are serialized, so the stall time needs no other lock
+        serial_stats_tx_stall_begin(&sd->stats);
+        mutex_unlock(&sd->write_mutex);
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(sd->tx_wait, !kfifo_is_full(&sd->tx_ring) || READ_ONCE(sd->dead)))
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&sd->write_mutex))
+            return -ERESTARTSYS;
+    }
+    serial_stats_tx_stall_end(&sd->stats);
+    if (READ_ONCE(sd->dead)) {
+        mutex_unlock(&sd->write_mutex);
+        return -ENODEV;
+    }
+    result = kfifo_from_user(&sd->tx_ring, buffer, count, &copied);
+    mutex_unlock(&sd->write_mutex);
+
+    spin_lock_irqsave(&sd->lock, flags);
+    if (sd->dead) {
+        spin_unlock_irqrestore(&sd->lock, flags);
+        return -ENODEV;
+    }
+    tx_fill(sd);
+    spin_unlock_irqrestore(&sd->lock, flags);
+
+    return copied ? copied : result;
+}
+
+static __poll_t serial_poll(struct file *file, poll_table *wait) {
+    struct serial_dev *sd = file_to_serial(file);
+    __poll_t mask = 0;
+
+    poll_wait(file, &sd->rx_wait, wait);
+    poll_wait(file, &sd->tx_wait, wait);
+    if (READ_ONCE(sd->dead))
+        return EPOLLERR | EPOLLHUP;
+    if (!kfifo_is_empty(&sd->rx_ring))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    if (!kfifo_is_full(&sd->tx_ring))
+        mask |= EPOLLOUT | EPOLLWRNORM;
+    return mask;
+}
+
+// Line configuration, covering the baud_rate, word_size and parity_mode
+// sysfs attributes plus the stop bits
+static long serial_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    struct serial_dev *sd = file_to_serial(file);
+    uint32_t __user *argp = (uint32_t __user *)arg;
+    uint32_t control, value;
+
+    if (READ_ONCE(sd->dead))
+        return -ENODEV;
+    control = read_register(sd, CONTROL_REG_OFFSET);
+
+    switch (cmd) {
+    case SERIAL_IOC_GET_BAUD:
+        return put_user(get_baud(sd), argp);
+    case SERIAL_IOC_GET_WORD_SIZE:
+        return put_user((control & DATA_LENGTH_MASK) + 5, argp);
+    case SERIAL_IOC_GET_PARITY:
+        return put_user((control & PARITY_MODE_MASK) >> 2, argp);
+    case SERIAL_IOC_GET_STOP_BITS:
+        return put_user((control & STOP_BITS_MASK) ? 2 : 1, argp);
+    case SERIAL_IOC_SET_BAUD:
+    case SERIAL_IOC_SET_WORD_SIZE:
+    case SERIAL_IOC_SET_PARITY:
+    case SERIAL_IOC_SET_STOP_BITS:
+        if (get_user(value, argp))
+            return -EFAULT;
+        break;
+    default:
+        return -ENOTTY;
+    }
 
-static struct attribute_group attr_group = {
-    .attrs = attrs
+    switch (cmd) {
+    case SERIAL_IOC_SET_BAUD:
+        if (set_baud(sd, value) == 0)
+            return -EINVAL;
+        break;
+    case SERIAL_IOC_SET_WORD_SIZE:
+        if (value < 5 || value > 8)
+            return -EINVAL;
+        update_control(sd, DATA_LENGTH_MASK, value - 5);
+        break;
+    case SERIAL_IOC_SET_PARITY:
+        if (value > 2)
+            return -EINVAL;
+        update_control(sd, PARITY_MODE_MASK, value << 2);
+        break;
+    case SERIAL_IOC_SET_STOP_BITS:
+        if (value != 1 && value != 2)
+            return -EINVAL;
+        update_control(sd, STOP_BITS_MASK, value == 2 ? STOP_BITS_MASK : 0);
+        break;
+    }
+    return 0;
+}
+
+static const struct file_operations serial_fops = {
+    .owner = THIS_MODULE,
+    .open = serial_open,
+    .release = serial_release,
+    .read = serial_read,
+    .write = serial_write,
+    .poll = serial_poll,
+    .unlocked_ioctl = serial_ioctl,
 };
 
-static struct kobject *kobj;
+// Platform driver: one /dev/serialipN per serial IP node, with registers
+// and interrupt from the node's reg and interrupts properties
+static int probe(struct platform_device* pdev) {
+    struct serial_dev *sd;
+    struct resource *res;
+    uint32_t cap;
+    int result;
+
+    sd = kzalloc(sizeof(*sd), GFP_KERNEL);
+    if (!sd)
+        return -ENOMEM;
+    kref_init(&sd->ref);
+    sd->dev = &pdev->dev;
+    INIT_KFIFO(sd->rx_ring);
+    INIT_KFIFO(sd->tx_ring);
+    spin_lock_init(&sd->lock);
+    mutex_init(&sd->read_mutex);
+    mutex_init(&sd->write_mutex);
+    init_waitqueue_head(&sd->rx_wait);
+    init_waitqueue_head(&sd->tx_wait);
+
+    // Not devm: ioctl() may still read the registers of a removed instance
+    // until its file is closed, so the mapping goes in serial_free()
+    res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+    if (!res || !devm_request_mem_region(&pdev->dev, res->start, resource_size(res), dev_name(&pdev->dev))) {
+        result = -EBUSY;
+        goto fail_free;
+    }
+    sd->base = ioremap(res->start, resource_size(res));
+    if (!sd->base) {
+        result = -ENOMEM;
+        goto fail_free;
+    }
+
+    result = platform_get_irq(pdev, 0);
+    if (result < 0)
+        goto fail_free;
+    sd->irq = result;
+
+    // Size the burst buffers to the hardware FIFOs
+    cap = read_register(sd, CAP_REG_OFFSET);
+    sd->rx_fifo_depth = CAP_RX_DEPTH(cap);
+    sd->tx_fifo_depth = CAP_TX_DEPTH(cap);
+    sd->rx_buf = kmalloc(sd->rx_fifo_depth, GFP_KERNEL);
+    sd->tx_buf = kmalloc(sd->tx_fifo_depth, GFP_KERNEL);
+    if (!sd->rx_buf || !sd->tx_buf) {
+        result = -ENOMEM;
+        goto fail_free;
+    }
+
+    sd->id = ida_alloc(&serial_ida, GFP_KERNEL);
+    if (sd->id < 0) {
+        result = sd->id;
+        goto fail_free;
+    }
+    snprintf(sd->name, sizeof(sd->name), SERIAL_DEVICE_NAME "%d", sd->id);
+    platform_set_drvdata(pdev, sd);
+
+    result = request_irq(sd->irq, serial_isr, IRQF_SHARED, dev_name(&pdev->dev), sd);
+    if (result != 0) {
+        dev_err(&pdev->dev, "request_irq returned %d\n", result);
+        goto fail_id;
+    }
+
+    // Interrupt at half the RX FIFO or after 4 idle character times
+    write_register(sd, RXCFG_REG_OFFSET, RXCFG(sd->rx_fifo_depth / 2, 4));
+    update_control(sd, RX_INT_MASKS, RX_INT_MASKS);
+
+    sd->misc.minor = MISC_DYNAMIC_MINOR;
+    sd->misc.name = sd->name;
+    sd->misc.fops = &serial_fops;
+    sd->misc.parent = &pdev->dev;
+    result = misc_register(&sd->misc);
+    if (result != 0) {
+        dev_err(&pdev->dev, "misc_register returned %d\n", result);
+        goto fail_irq;
+    }
+
+    sd->stats_dir = serial_stats_debugfs(sd->name, stats_root, &sd->stats);
+
+    dev_info(&pdev->dev, "/dev/%s on irq %u\n", sd->name, sd->irq);
+    return 0;
+
+fail_irq:
+    update_control(sd, RX_INT_MASKS, 0);
+    free_irq(sd->irq, sd);
+fail_id:
+    ida_free(&serial_ida, sd->id);
+fail_free:
+    kref_put(&sd->ref, serial_free);
+    return result;
+}
+
+// Files still open keep the instance; they see it dead and get -ENODEV
+static int remove(struct platform_device* pdev) {
+    struct serial_dev *sd = platform_get_drvdata(pdev);
+    unsigned long flags;
+
+    misc_deregister(&sd->misc);
+
+    spin_lock_irqsave(&sd->lock, flags);
+    WRITE_ONCE(sd->dead, true);
+    set_control(sd, RX_INT_MASKS | INT_ON_TX_MASK, 0);
+    sd->tx_int_enabled = false;
+    sd->rx_throttled = false;
+    spin_unlock_irqrestore(&sd->lock, flags);
+    free_irq(sd->irq, sd);
+    wake_up_interruptible(&sd->rx_wait);
+    wake_up_interruptible(&sd->tx_wait);
+
+    debugfs_remove_recursive(sd->stats_dir);
+    ida_free(&serial_ida, sd->id);
+    kref_put(&sd->ref, serial_free);
+    return 0;
+}
+
+static struct of_device_id driver_of_match[] = {
+    {.compatible = "xlnx,soc-axi4lite-reserved-j1", },
+    {}
+};
+MODULE_DEVICE_TABLE(of, driver_of_match);
+
+static struct platform_driver driver = {
+    .probe = probe,
+    .remove = remove,
+    .driver = {
+        .name = "serial driver",
+        .owner = THIS_MODULE,
+        .of_match_table = driver_of_match,
+        .dev_groups = serial_groups,
+    },
+};
 
 // Module Init/Exit
 static int __init initialize_module(void) {
     int result;
 
 	printk(KERN_INFO "Serial driver: starting\n");
-	
-    // Create serial directory under /sys/kernel
-    kobj = kobject_create_and_add("serial", NULL);
-    if (!kobj) {
-        printk(KERN_ALERT "Serial driver: failed to create and add kobj\n");
-        return -ENOENT;
-    }
 
-    result = sysfs_create_group(kobj, &attr_group);
-    if (result !=0) 
+    stats_root = debugfs_create_dir("serial_driver", NULL);
+
+    // Bind the serial IP instances
+    result = platform_driver_register(&driver);
+    if (result != 0) {
+        printk(KERN_ALERT "Serial driver: failed to register platform driver\n");
+        debugfs_remove_recursive(stats_root);
         return result;
-	
-	 // Physical to virtual memory map to access gpio registers
-    base = (unsigned int*)ioremap(AXI4_LITE_BASE + SERIAL_BASE_OFFSET,
-                                          SPAN_IN_BYTES);
-    if (base == NULL)
-        return -ENODEV;
+    }
 
     printk(KERN_INFO "Serial driver: initialized\n");
 
@@ -173,10 +681,11 @@ static int __init initialize_module(void) {
 }
 
 static void __exit exit_module(void) {
-    kobject_put(kobj);
+    platform_driver_unregister(&driver);
+    debugfs_remove_recursive(stats_root);
+    ida_destroy(&serial_ida);
     printk(KERN_INFO "Serial Driver: exit\n");
 }
 
 module_init(initialize_module);
 module_exit(exit_module);
-
@@ -0,0 +1,52 @@
+// Serial IP Character Device Interface
+// Olajumoke Aboderin
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Xilinx XUP Blackboard
+
+// ioctl numbers for /dev/serialipN (serial_driver.ko), shared by the driver
+// and user space. Every request takes a pointer to a __u32:
+//   SERIAL_IOC_SET_BAUD        baud rate in bits/s
+//   SERIAL_IOC_SET_WORD_SIZE   5 to 8 data bits
+//   SERIAL_IOC_SET_PARITY      0 = none, 1 = even, 2 = odd
+//   SERIAL_IOC_SET_STOP_BITS   1 or 2
+// and the matching GET requests return the current setting.
+// The core stays disabled until a baud rate is set (here or through the
+// baud_rate attribute), so a port configured only through ioctls needs
+// SERIAL_IOC_SET_BAUD before it moves any data:
+//   int fd = open("/dev/serialip0", O_RDWR);
+//   __u32 baud = 115200, bits = 8, parity = 0, stop = 1;
+//   ioctl(fd, SERIAL_IOC_SET_BAUD, &baud);       // also enables the core
+//   ioctl(fd, SERIAL_IOC_SET_WORD_SIZE, &bits);
+//   ioctl(fd, SERIAL_IOC_SET_PARITY, &parity);
+//   ioctl(fd, SERIAL_IOC_SET_STOP_BITS, &stop);
+//   write(fd, "hello\n", 6);
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef SERIAL_IOCTL_H_
+#define SERIAL_IOCTL_H_
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+// Device node prefix; instance N is /dev/serialipN
+#define SERIAL_DEVICE_NAME "serialip"
+
+#define SERIAL_IOC_MAGIC 'S'
+
+#define SERIAL_IOC_SET_BAUD       _IOW(SERIAL_IOC_MAGIC, 1, __u32)
+#define SERIAL_IOC_GET_BAUD       _IOR(SERIAL_IOC_MAGIC, 2, __u32)
+#define SERIAL_IOC_SET_WORD_SIZE  _IOW(SERIAL_IOC_MAGIC, 3, __u32)
+#define SERIAL_IOC_GET_WORD_SIZE  _IOR(SERIAL_IOC_MAGIC, 4, __u32)
+#define SERIAL_IOC_SET_PARITY     _IOW(SERIAL_IOC_MAGIC, 5, __u32)
+#define SERIAL_IOC_GET_PARITY     _IOR(SERIAL_IOC_MAGIC, 6, __u32)
+#define SERIAL_IOC_SET_STOP_BITS  _IOW(SERIAL_IOC_MAGIC, 7, __u32)
+#define SERIAL_IOC_GET_STOP_BITS  _IOR(SERIAL_IOC_MAGIC, 8, __u32)
+
+#endif
@@ -1,317 +1,460 @@
 #include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h> 
+#include <stdlib.h>
 #include <stdbool.h>
 #include <fcntl.h>
-#include <sys/mman.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include "../address_map.h"
+#include "serialip.h"
 
-#define CLK_FREQ 100000000 
-#define SPAN_IN_BYTES 32
-#define SERIAL_BASE_OFFSET 0x20000
-#define DATA_REG_OFFSET    0
-#define STATUS_REG_OFFSET  1
-#define CONTROL_REG_OFFSET 2
-#define BRD_REG_OFFSET     3
+// Streaming buffer size and default RX idle timeout
+#define STREAM_CHUNK       4096
+#define STREAM_IDLE_MS     1000
 
-// Status register bit masks
-#define FIFO_EMPTY_MASK    (1 << 0)
-#define FIFO_FULL_MASK     (1 << 2)
-#define FIFO_OVERFLOW_MASK (1 << 4)
+// Batch mode limits
+#define BATCH_LINE_MAX     4096
+#define BATCH_ARGS_MAX     256
 
-// Control register bit masks
-#define ENABLE_MASK (1 << 4)
-#define TEST_MASK 	(1 << 5)
-#define DATA_LENGTH_MASK   0x03  
-#define PARITY_MODE_MASK   0x0C  
-#define STOP_BITS_MASK     0x100  
-
-// BRD register bit masks
-#define IBRD_OFFSET		8
-#define FBRD_MASK 		0xFF  
-
-uint32_t *base = NULL; 
+serial_dev_t *dev = NULL;
 
 void printBinary(uint32_t num);
-bool serialOpen(void);
 void printUsage(void);
 void printFifoStatus(uint32_t status);
-uint32_t readData(void);
-void writeData(uint32_t value);
-uint32_t readStatus(void);
-uint32_t readBaudRate(void);
-void setBaudRate(float baudRate);
-void enableBRD(void);
-void disableBRD(void);
-void enableTest(void);
-void disableTest(void);
-void clear_OV(void);
-void setDataLength(uint8_t dl);
-void setParityMode(uint8_t mode);
-void setStopBits(uint8_t bits);
+int runCommand(int argc, char* argv[]);
+int runBatch(void);
+int streamTx(const char *path);
+int streamRx(const char *path, uint64_t limit, uint32_t idle_ms);
+int rxWait(const char *path, uint64_t limit, int idle_ms);
 
 
 int main(int argc, char* argv[])
 {
-	uint32_t data, status;
-	float baudrate;
+	const char *uio = NULL;
+	int result;
+
+	// --uio /dev/uioN maps the IP through UIO instead of /dev/mem
+	if (argc >= 3 && strcmp(argv[1], "--uio") == 0) {
+		uio = argv[2];
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc < 2 || strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "--h") == 0) {
+		printUsage();
+		return EXIT_SUCCESS;
+	}
+
+	// One mapping for the whole process, however many commands it runs
+	if (uio)
+		dev = serial_open_uio(uio);
+	else
+		dev = serial_open(AXI4_LITE_BASE + SERIAL_BASE_OFFSET);
+	if (!dev) {
+		printf("Cannot map serial registers: %s\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if (strcmp(argv[1], "--batch") == 0)
+		result = runBatch();
+	else
+		result = runCommand(argc, argv);
+
+	serial_close(dev);
+	return result;
+}
+
+// Run commands from stdin, one per line with the same syntax as the
+// command line (blank lines and # comments are skipped, "quit" ends)
+int runBatch(void)
+{
+	char line[BATCH_LINE_MAX];
+	char *args[BATCH_ARGS_MAX];
+	int failures = 0;
+
+	while (fgets(line, sizeof(line), stdin)) {
+		int count = 0;
+		char *token = strtok(line, " \t\r\n");
+
+		args[count++] = "serial";
+		while (token && count < BATCH_ARGS_MAX) {
+			args[count++] = token;
+			token = strtok(NULL, " \t\r\n");
+		}
+		if (count == 1 || args[1][0] == '#')
+			continue;
+		if (strcmp(args[1], "quit") == 0 || strcmp(args[1], "exit") == 0)
+			break;
+
+		if (runCommand(count, args) != EXIT_SUCCESS)
+			failures++;
+		fflush(stdout);
+	}
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int runCommand(int argc, char* argv[])
+{
+	uint32_t status;
+	uint32_t baudrate;
 	if (argc >= 2 && (strcmp(argv[1], "read") == 0 || strcmp(argv[1], "r") == 0)) {
         // Read operation
-		serialOpen();
         int num_reads = 1; //default number of reads
         if (argc > 2) {
             num_reads = atoi(argv[2]);
             if (num_reads <= 0){
 				//verify valid number of reads
-				num_reads = 1; 
+				num_reads = 1;
 			}
         }
 
-        for (int i = 0; i < num_reads; i++) {
-            status = readStatus();
-            if (!(status & FIFO_EMPTY_MASK)) {
-                data = readData();
-                printf("Read data[%d]: %d\n", i, data);
-            } else {
-                printf("FIFO is empty\n");
-                break;
-            }
-        }
-		
+        // Read what the RX FIFO holds, four bytes per access where possible
+        uint8_t *data = malloc(num_reads);
+        if (!data)
+            return EXIT_FAILURE;
+        size_t count = serial_read_buf(dev, data, num_reads);
+        for (size_t i = 0; i < count; i++)
+            printf("Read data[%zu]: %d\n", i, data[i]);
+        if (count < (size_t)num_reads)
+            printf("FIFO is empty\n");
+        free(data);
+
     }else if (argc >= 3 && (strcmp(argv[1], "write") == 0 || strcmp(argv[1], "w") == 0)) {
         // Write operation
-		serialOpen();
-        // Process each value provided
-        for (int i = 2; i < argc; i++) {
-            status = readStatus();
-            if (!(status & FIFO_FULL_MASK)) {
-                data = (uint32_t)strtoul(argv[i], NULL, 0);
-				writeData(data);
-                printf("Successfully wrote %d\n", data);
-                
-            } else {
-				data = (uint32_t)strtoul(argv[i], NULL, 0);
-				//writeData(data);
-                //printf("Wrote %d. FIFO is now full\n", data);
-				printf("FIFO is now full\n");
-                break;
-            }
-        }
+        // Process each value provided, filling the free TX FIFO slots
+        // four bytes per access where possible
+        int num_writes = argc - 2;
+        uint8_t *data = malloc(num_writes);
+        if (!data)
+            return EXIT_FAILURE;
+        for (int i = 0; i < num_writes; i++)
+            data[i] = (uint8_t)strtoul(argv[i + 2], NULL, 0);
+        size_t count = serial_write_buf(dev, data, num_writes);
+        for (size_t i = 0; i < count; i++)
+            printf("Successfully wrote %d\n", data[i]);
+        if (count < (size_t)num_writes)
+            printf("FIFO is now full\n");
+        free(data);
+    }
+    else if (argc >= 2 && strcmp(argv[1], "stream-tx") == 0) {
+        // Stream a file (or stdin) to the TX FIFO
+		return streamTx(argc > 2 ? argv[2] : "-");
+    }
+    else if (argc >= 2 && strcmp(argv[1], "stream-rx") == 0) {
+        // Dump the RX FIFO to a file (or stdout) in binary
+		uint64_t limit = argc > 3 ? strtoull(argv[3], NULL, 0) : 0;
+		uint32_t idle_ms = argc > 4 ? strtoul(argv[4], NULL, 0) : STREAM_IDLE_MS;
+		return streamRx(argc > 2 ? argv[2] : "-", limit, idle_ms);
+    }
+    else if (argc >= 2 && strcmp(argv[1], "rx-wait") == 0) {
+        // Sleep on the RX interrupt and dump RX to a file (or stdout)
+		uint64_t limit = argc > 3 ? strtoull(argv[3], NULL, 0) : 0;
+		int idle_ms = argc > 4 ? atoi(argv[4]) : -1;
+		return rxWait(argc > 2 ? argv[2] : "-", limit, idle_ms);
     }
     else if (strcmp(argv[1], "status") == 0 || strcmp(argv[1], "s") == 0) {
-        // Status 
-		serialOpen();
-        status = readStatus();
+        // Status
+        status = serial_status(dev);
         printFifoStatus(status);
     }
 	else if (strcmp(argv[1], "clear") == 0 || strcmp(argv[1], "co") == 0) {
-        // Status 
-		serialOpen();
-		clear_OV();
+        // Status
+		serial_clear_status(dev, RXOV | TXOV);
     }
 	else if (argc == 3 && (strcmp(argv[1], "baudrate") == 0 || strcmp(argv[1], "b") == 0)){
 		// Set baud rate
-		serialOpen();
-		baudrate = strtof(argv[2], NULL);
-		if (baudrate <= 0){
+		baudrate = strtoul(argv[2], NULL, 0);
+		if (baudrate == 0 || (baudrate = serial_set_baud(dev, baudrate)) == 0){
 			printf("Invalid baud rate entered.");
+			return EXIT_FAILURE;
 		}else {
-			setBaudRate(baudrate);
+			printf("Baud rate set to %u (%ux oversampling)\n", baudrate,
+			       OSR_TICKS((serial_read_reg(dev, CONTROL_REG_OFFSET) & OSR_MASK) >> OSR_OFFSET));
+			printf("BRD Register: ");
+			printBinary(serial_get_brd(dev));
 		}
 	}
 	else if (argc == 2 && (strcmp(argv[1], "baudrate") == 0 || strcmp(argv[1], "b") == 0)){
-		// Set baud rate
-		serialOpen();
-		printf("Baud rate is ");
-		printBinary(readBaudRate());
+		// Get baud rate
+		printf("Baud rate is %u, BRD Register: ", serial_get_baud(dev));
+		printBinary(serial_get_brd(dev));
 	}
 	else if (strcmp(argv[1], "enable") == 0){
 		// enable brd
-		serialOpen();
-		enableBRD();
+		serial_enable(dev, true);
 	}
 	else if (strcmp(argv[1], "disable") == 0){
 		// disable brd
-		serialOpen();
-		disableBRD();
+		serial_enable(dev, false);
 	}
 	else if (strcmp(argv[1], "test") == 0){
 		// turn on/off test
-		if(argc > 2 && strcmp(argv[2], "off") == 0){
-			serialOpen();
-			disableTest();
-		}else{
-			serialOpen();
-			enableTest();
-		}
+		serial_set_test(dev, !(argc > 2 && strcmp(argv[2], "off") == 0));
+	}
+	else if (strcmp(argv[1], "loopback") == 0){
+		// turn on/off internal loopback (TX feeds RX inside the IP)
+		serial_set_loopback(dev, !(argc > 2 && strcmp(argv[2], "off") == 0));
+	}
+	else if (strcmp(argv[1], "flow") == 0){
+		// turn on/off RTS/CTS flow control, optionally with the RTS level
+		bool on = !(argc > 2 && strcmp(argv[2], "off") == 0);
+		uint16_t level = (on && argc > 2) ? atoi(argv[2]) : 0;
+		serial_set_flow(dev, on, level);
 	}
 	else if (strcmp(argv[1], "setup") == 0){
 		// settings for transmission
-		
-		serialOpen();
 	}
 	else if (strcmp(argv[1], "dl") == 0){
 		// settings for transmission
-		if(argc > 2){
-			uint8_t dl = atoi(argv[2]);
-            if (dl >= 5 || dl <= 8){
-				serialOpen();
-				setDataLength(dl);
-				
-			}else {
-				printf("usage: sudo ./serial dl DATA_LENGTH(5 TO 8)");
-			}
-			
-		}else{
+		uint8_t dl = argc > 2 ? atoi(argv[2]) : 0;
+		if (dl >= 5 && dl <= 8){
+			serial_set_data_length(dev, dl);
+		}else {
 			printf("usage: sudo ./serial dl DATA_LENGTH(5 TO 8)");
+			return EXIT_FAILURE;
 		}
 	}
 	else if (strcmp(argv[1], "p") == 0){
 		// settings for transmission
-		if(argc > 2){
-			uint8_t mode = atoi(argv[2]);
-            if (mode >= 0 || mode <= 2){
-				serialOpen();
-				setParityMode(mode);
-				
-			}else{
-				printf("usage: sudo ./serial p [0,1,2]");
-			}
-			
+		uint8_t mode = argc > 2 ? atoi(argv[2]) : 3;
+		if (mode <= 2){
+			serial_set_parity(dev, mode);
 		}else{
 			printf("usage: sudo ./serial p [0,1,2]");
+			return EXIT_FAILURE;
 		}
 	}
 	else if (strcmp(argv[1], "stop") == 0){
 		// settings for transmission
-		if(argc > 2){
-			uint8_t stop = atoi(argv[2]);
-            if (stop == 1 || stop == 2){
-				serialOpen();
-				setStopBits(stop);
-				
-			}else{
-				printf("usage: sudo ./serial stop [1,2]");
-			}
-			
+		uint8_t stop = argc > 2 ? atoi(argv[2]) : 0;
+		if (stop == 1 || stop == 2){
+			serial_set_stop_bits(dev, stop);
 		}else{
 			printf("usage: sudo ./serial stop [1,2]");
+			return EXIT_FAILURE;
 		}
 	}
 	else if(strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "--h") == 0){
 		printUsage();
-		//return 1;
 	}
     else {
         printf("Invalid command\n");
         printUsage();
-        //return 1;
+        return EXIT_FAILURE;
     }
 
 return EXIT_SUCCESS;
 }
 
-bool serialOpen()
-{
-	int file = open("/dev/mem", O_RDWR | O_SYNC);
-	bool bOK = (file >= 0);
-	if(bOK){
-		base = mmap(NULL, SPAN_IN_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED,
-			file, AXI4_LITE_BASE + SERIAL_BASE_OFFSET);
-		bOK = (base != MAP_FAILED);
-
-
-		//Close /dev/mem
-		close(file);
-	}
-return bOK;
-
-}
-
 void printFifoStatus(uint32_t status) {
     printf("FIFO Status: ");
 	printBinary(status);
-    printf("Empty: %s\n", (status & FIFO_EMPTY_MASK) ? "Yes" : "No");
-    printf("Full: %s\n", (status & FIFO_FULL_MASK) ? "Yes" : "No");
-    printf("Overflow: %s\n", (status & FIFO_OVERFLOW_MASK) ? "Yes" : "No");
+    printf("RX Empty: %s\n", (status & RXFE) ? "Yes" : "No");
+    printf("RX Full: %s\n", (status & RXFF) ? "Yes" : "No");
+    printf("RX Overflow: %s\n", (status & RXOV) ? "Yes" : "No");
+    printf("TX Empty: %s\n", (status & TXFE) ? "Yes" : "No");
+    printf("TX Full: %s\n", (status & TXFF) ? "Yes" : "No");
+    printf("TX Overflow: %s\n", (status & TXOV) ? "Yes" : "No");
+    printf("RTS: %s, CTS: %s\n", (status & RTS) ? "On" : "Off", (status & CTS) ? "On" : "Off");
+
+    uint32_t level = serial_read_reg(dev, LEVEL_REG_OFFSET);
+    printf("RX FIFO: %u of %u entries\n", LEVEL_RX(level), serial_rx_depth(dev));
+    printf("TX FIFO: %u of %u entries\n", LEVEL_TX(level), serial_tx_depth(dev));
 }
 
-uint32_t readData() {
-	uint32_t value = *(base + DATA_REG_OFFSET);
-    return value;
+static double elapsedSeconds(const struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
 }
 
-void writeData(uint32_t value) {
-    *(base + DATA_REG_OFFSET) = value;
+static void printStreamStats(const char *name, uint64_t bytes, double seconds,
+                             uint64_t stalls, uint64_t overflows) {
+	// Stats go to stderr so stdout can carry the data
+	fprintf(stderr, "%s: %llu bytes in %.3f s (%.0f bytes/s), %llu FIFO-full stalls, %llu overflows\n",
+	        name, (unsigned long long)bytes, seconds, seconds > 0 ? bytes / seconds : 0.0,
+	        (unsigned long long)stalls, (unsigned long long)overflows);
 }
 
-uint32_t readStatus(void) {
-	uint32_t value = *(base + STATUS_REG_OFFSET);
-    return value;
-}
+// Pipe a file (or stdin for "-") to the TX FIFO
+// serial_write_buf fills exactly the free slots reported by the TX level,
+// four bytes per packed access; when the FIFO is full the tool waits for
+// it to drain instead of giving up. Returns once the FIFO has emptied
+int streamTx(const char *path) {
+	static uint8_t buf[STREAM_CHUNK];
+	uint64_t total = 0, stalls = 0, overflows = 0;
+	bool stalled = false;
+	struct timespec start;
+	ssize_t len;
+	int fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY);
+
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
 
-void setBaudRate(float baudRate) {
-    float divisor = (float)(CLK_FREQ / (32 * baudRate));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		size_t i = 0;
+		while (i < (size_t)len) {
+			size_t n = serial_write_buf(dev, buf + i, len - i);
 
-    uint32_t ibrd = (uint32_t)divisor;                    
-    uint8_t fbrd = (uint8_t)((divisor - ibrd) * 256);   
+			if (serial_status(dev) & TXOV) {
+				overflows++;
+				serial_clear_status(dev, TXOV);
+			}
+			if (n == 0) {
+				if (!stalled)
+					stalls++;
+				stalled = true;
+				continue;
+			}
+			stalled = false;
+			i += n;
+		}
+		total += len;
+	}
+	if (len < 0)
+		fprintf(stderr, "Read error on %s: %s\n", path, strerror(errno));
 
-    //printf("Baud rate: %d (ibrd = %d, fbrd = %d)\n", baudRate, ibrd, fbrd);
-	printf("BRD Register: ");
-	printBinary((ibrd << IBRD_OFFSET) | (fbrd & FBRD_MASK));
-    *(base + BRD_REG_OFFSET) = (ibrd << IBRD_OFFSET) | (fbrd & FBRD_MASK);
-}
+	// Count the time to put the last bytes on the line
+	while (!(serial_status(dev) & TXFE))
+		;
+	printStreamStats("stream-tx", total, elapsedSeconds(&start), stalls, overflows);
 
-uint32_t readBaudRate(void) {
-	uint32_t value = *(base + BRD_REG_OFFSET);
-    return value;
+	if (fd != STDIN_FILENO)
+		close(fd);
+	return len < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
-void enableBRD(void){
-	*(base + CONTROL_REG_OFFSET)|= ENABLE_MASK;
-}
+// Dump the RX FIFO to a file (or stdout for "-") in binary
+// Stops after limit bytes (0 = no limit) or once no data has arrived for
+// idle_ms; the clock starts at the first byte received. A stall here is
+// the RX FIFO found full, i.e. the tool fell behind the line
+int streamRx(const char *path, uint64_t limit, uint32_t idle_ms) {
+	static uint8_t buf[STREAM_CHUNK];
+	uint64_t total = 0, stalls = 0, overflows = 0;
+	bool full = false;
+	struct timespec start, last;
+	int fd = (strcmp(path, "-") == 0) ? STDOUT_FILENO
+	                                  : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
 
-void disableBRD(void){
-	*(base + CONTROL_REG_OFFSET) &= ~ENABLE_MASK;
-}
+	clock_gettime(CLOCK_MONOTONIC, &last);
+	start = last;
+	while (limit == 0 || total < limit) {
+		uint32_t status = serial_status(dev);
+		size_t want = sizeof(buf), n;
 
-void enableTest(void){
-	*(base + CONTROL_REG_OFFSET)|= TEST_MASK;
-}
+		if (status & RXOV) {
+			overflows++;
+			serial_clear_status(dev, RXOV);
+		}
+		if ((status & RXFF) && !full)
+			stalls++;
+		full = (status & RXFF) != 0;
+
+		if (limit != 0 && want > limit - total)
+			want = limit - total;
+		n = serial_read_buf(dev, buf, want);
+		if (n == 0) {
+			if (elapsedSeconds(&last) * 1000 >= idle_ms)
+				break;
+			continue;
+		}
 
-void disableTest(void){
-	*(base + CONTROL_REG_OFFSET) &= ~TEST_MASK;
-}
+		if (total == 0)
+			clock_gettime(CLOCK_MONOTONIC, &start);
+		clock_gettime(CLOCK_MONOTONIC, &last);
+		if (write(fd, buf, n) != (ssize_t)n) {
+			fprintf(stderr, "Write error on %s: %s\n", path, strerror(errno));
+			break;
+		}
+		total += n;
+	}
 
-void clear_OV(void){
-	*(base + STATUS_REG_OFFSET) = 0x01;
-}
+	// Don't count the trailing idle timeout against the throughput
+	double seconds = (last.tv_sec - start.tv_sec) + (last.tv_nsec - start.tv_nsec) / 1e9;
+	printStreamStats("stream-rx", total, seconds, stalls, overflows);
 
-void setDataLength(uint8_t dl){
-	
-    uint32_t control = *(base + CONTROL_REG_OFFSET);
-    control &= ~DATA_LENGTH_MASK;           // Clear current data length bits
-    control |= (dl - 5);                    // Set new data length (5 to 8 bits)
-    *(base + CONTROL_REG_OFFSET) = control;
+	if (fd != STDOUT_FILENO)
+		close(fd);
+	return EXIT_SUCCESS;
 }
 
+// Interrupt-driven RX over UIO: sleep on the UIO descriptor until the IP
+// raises its RX trigger or RX timeout interrupt, drain the FIFO, then re-arm
+// the line. The level-triggered line fires again at once if data arrived
+// while draining, so nothing is missed and no CPU is used while idle
+// Stops after limit bytes (0 = no limit) or idle_ms without an interrupt
+// (-1 = wait forever)
+int rxWait(const char *path, uint64_t limit, int idle_ms) {
+	static uint8_t buf[STREAM_CHUNK];
+	uint64_t total = 0, wakeups = 0;
+	uint32_t rx_ints = INT_ON_RX_MASK | INT_ON_RX_TIMEOUT_MASK;
+	struct timespec start;
+	int ret = 0, fd;
+
+	if (serial_uio_fd(dev) < 0) {
+		fprintf(stderr, "rx-wait needs a UIO mapping (--uio /dev/uioN)\n");
+		return EXIT_FAILURE;
+	}
+	fd = (strcmp(path, "-") == 0) ? STDOUT_FILENO
+	                              : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
 
-void setParityMode(uint8_t mode){
-	uint32_t control = *(base + CONTROL_REG_OFFSET);
-    control &= ~PARITY_MODE_MASK;            // Clear current parity bits
-    control |= (mode << 2);                  // Set new parity mode bits
-    *(base + CONTROL_REG_OFFSET) = control;
-}
+	// Interrupt once half the FIFO is waiting or after 4 idle character times
+	serial_write_reg(dev, RXCFG_REG_OFFSET, RXCFG(serial_rx_depth(dev) / 2, 4));
+	serial_update_reg(dev, CONTROL_REG_OFFSET, rx_ints, rx_ints);
+	serial_irq_enable(dev);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (limit == 0 || total < limit) {
+		ret = serial_irq_wait(dev, idle_ms, NULL);
+		if (ret <= 0)
+			break;
+		wakeups++;
+
+		for (;;) {
+			size_t want = sizeof(buf), n;
+
+			if (limit != 0 && want > limit - total)
+				want = limit - total;
+			n = serial_read_buf(dev, buf, want);
+			if (n == 0)
+				break;
+			if (write(fd, buf, n) != (ssize_t)n) {
+				fprintf(stderr, "Write error on %s: %s\n", path, strerror(errno));
+				ret = -1;
+				break;
+			}
+			total += n;
+		}
+		if (ret < 0)
+			break;
+		serial_irq_enable(dev);
+	}
+	if (ret < 0)
+		fprintf(stderr, "rx-wait: %s\n", strerror(errno));
 
-void setStopBits(uint8_t bits){
-	uint32_t control = *(base + CONTROL_REG_OFFSET);
-    control &= ~STOP_BITS_MASK;              // Clear current stop bits setting
-    if (bits == 2) {
-        control |= STOP_BITS_MASK;           // Set stop bits to 2
-    }
-    *(base + CONTROL_REG_OFFSET) = control;
+	serial_update_reg(dev, CONTROL_REG_OFFSET, rx_ints, 0);
+	fprintf(stderr, "rx-wait: %llu bytes, %llu wakeups (%.1f bytes/wakeup) in %.3f s\n",
+	        (unsigned long long)total, (unsigned long long)wakeups,
+	        wakeups ? (double)total / wakeups : 0.0, elapsedSeconds(&start));
+
+	if (fd != STDOUT_FILENO)
+		close(fd);
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 void printUsage() {
@@ -325,21 +468,36 @@ void printUsage() {
 	printf("  Set baud rate:\n");
     printf("    ./serial baudrate value\n");
     printf("   	./serial b value\n");
+    printf("  Stream a file to TX (stdin if omitted or -):\n");
+    printf("    ./serial stream-tx optional: file\n");
+    printf("  Stream RX to a file in binary (stdout if omitted or -):\n");
+    printf("    ./serial stream-rx optional: file max_bytes idle_ms\n");
+    printf("  Internal loopback (TX feeds RX, see serial_bench):\n");
+    printf("    ./serial loopback optional: off\n");
+    printf("  RTS/CTS flow control (RTS drops at rts_level RX entries, 0 = full):\n");
+    printf("    ./serial flow optional: rts_level | off\n");
     printf("  Check status:\n");
     printf("    ./serial status\n");
     printf("    ./serial s\n");
+    printf("  Run commands from stdin over one mapping:\n");
+    printf("    ./serial --batch\n");
+    printf("  Sleep on the RX interrupt and dump RX (needs --uio):\n");
+    printf("    ./serial --uio /dev/uio0 rx-wait optional: file max_bytes idle_ms\n");
     printf("\nNotes:\n");
     printf("- Values can be in decimal or hex (prefix with 0x)\n");
     printf("- Multiple writes can be specified in a single command\n");
     printf("- Optional num_reads parameter specifies how many reads to perform\n");
+    printf("- Streams report bytes/s, FIFO-full stalls and overflows on stderr\n");
+    printf("- Batch mode takes one command per line without the ./serial prefix;\n");
+    printf("  # starts a comment and quit ends the batch\n");
+    printf("- --uio /dev/uioN before any command maps the IP through UIO\n");
+    printf("  (see serial_uio.dtsi) instead of /dev/mem\n");
 }
 
 void printBinary(uint32_t num) {
     for (int i = 31; i >= 0; i--) {
         printf("%d", (num >> i) & 1);
-        if (i % 8 == 0 && i != 0) printf(" "); 
+        if (i % 8 == 0 && i != 0) printf(" ");
     }
     printf("\n");
 }
-
-
@@ -3,6 +3,10 @@
 // Serial IP ISR Default Handler (serial_isr.c)
 // Olajumoke Aboderin
 
+// Each serial IP node in the device tree gets its own /dev/serialip_rxN
+// (N counting up from 0 in probe order), which blocks until the ISR has
+// queued data and returns everything available in one call
+
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/interrupt.h>
@@ -12,15 +16,24 @@
 #include <linux/platform_device.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
-#include <linux/of_irq.h>
 #include <linux/types.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include <linux/mm.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/idr.h>
+#include <linux/kref.h>
+#include <linux/debugfs.h>
 #include <asm/io.h>
-#include "../address_map.h"
 #include "serial_regs.h"
+#include "serial_stats.h"
 
-uint32_t *serial = NULL;
-
-#define FIFO_SIZE 1024
+#define CREATE_TRACE_POINTS
+#include "serial_isr_trace.h"
 
 // Kernel module information
 
@@ -28,52 +41,338 @@ MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Olajumoke Aboderin");
 MODULE_DESCRIPTION("Serial IP Interrupt Handler");
 
+// RX interrupt moderation
+static unsigned int rx_trigger = 8;
+module_param(rx_trigger, uint, 0444);
+MODULE_PARM_DESC(rx_trigger, "RX FIFO trigger level in bytes");
+
+static unsigned int rx_timeout = 4;
+module_param(rx_timeout, uint, 0444);
+MODULE_PARM_DESC(rx_timeout, "RX idle timeout in character times (0 = off)");
+
+static unsigned int ring_size = 4096;
+module_param(ring_size, uint, 0444);
+MODULE_PARM_DESC(ring_size, "Software RX ring size in bytes (rounded up to a power of 2)");
+
+// Per-instance state, one per serial IP node
+// Software RX ring: single producer (the ISR) and single consumer (readers,
+// serialized by read_mutex). head and tail run freely and are masked on
+// access; the producer publishes head with a release store after writing
+// the data and the consumer publishes tail the same way after copying it
+// out, so each side's acquire load orders its accesses to the ring
+// Each open file holds a reference, so the instance and its ring outlive
+// remove() until the last close; reads on a dead instance get -ENODEV
+struct serial_isr_dev {
+    struct kref ref;
+    bool dead;
+    uint32_t __iomem *base;
+    unsigned int irq;
+    int id;
+    char name[16];
+    struct miscdevice misc;
+    char *ring;
+    unsigned int ring_mask;
+    unsigned int ring_head;
+    unsigned int ring_tail;
+    struct mutex read_mutex;
+    wait_queue_head_t rx_wait;
+
+    // Ring peak fill level; drops and the rest are in stats
+    // (debugfs serial_isr/serialip_rxN/stats)
+    unsigned int high_water;
+    struct serial_stats stats;
+    struct dentry *stats_dir;
+};
+
+static DEFINE_IDA(serial_ida);
+static struct dentry *stats_root = NULL;
+
+// Last reference gone: remove() has run (or probe failed) and no file
+// still has the device open
+static void serial_isr_free(struct kref *ref) {
+    struct serial_isr_dev *sd = container_of(ref, struct serial_isr_dev, ref);
+
+    kvfree(sd->ring);
+    kfree(sd);
+}
+
 //ISR
 
-static char fifo[FIFO_SIZE];
-static int wr_index = 0, rd_index = 0;
+// Store one byte, or count it as dropped when the reader is a whole ring behind
+static inline void ring_put(struct serial_isr_dev *sd, unsigned int *head, unsigned int tail, char data) {
+    if (*head - tail > sd->ring_mask) {
+        sd->stats.ring_drops++;
+        return;
+    }
+    sd->ring[*head & sd->ring_mask] = data;
+    (*head)++;
+}
 
+// One status read per burst: read exactly rx_watermark bytes back to back
+// (four at a time through the packed register), then re-read the status
+// only to catch bytes that arrived meanwhile. The line is shared, so an
+// interrupt with no RX data and no error flags is not ours: IRQ_NONE lets
+// genirq catch a sharer that is stuck asserting it
 static irqreturn_t isr(int irq, void *dev_id) {
-    while (!(ioread32(serial + STATUS_REG_OFFSET) & RXFE)) {
-        char data = ioread32(serial + DATA_REG_OFFSET);
-        fifo[wr_index] = data;
-        wr_index = (wr_index + 1) % FIFO_SIZE;
+    struct serial_isr_dev *sd = dev_id;
+    uint32_t status = ioread32(sd->base + STATUS_REG_OFFSET);
+    unsigned int head = sd->ring_head;
+    unsigned int tail = smp_load_acquire(&sd->ring_tail);
+    unsigned int start = head;
+    unsigned int total = 0;
+    uint32_t packed, sticky;
+    unsigned int count, i;
+
+    trace_irq_entry(status);
+
+    // Count and clear overflow and line errors (write 1 to clear)
+    sticky = serial_stats_status(&sd->stats, status);
+    if (sticky)
+        iowrite32(sticky, sd->base + STATUS_REG_OFFSET);
+    else if (!RX_WATERMARK(status))
+        return IRQ_NONE;    // another instance on the shared line
+
+    while ((count = RX_WATERMARK(status)) != 0) {
+        total += count;
+        for (; count >= 4; count -= 4) {
+            packed = ioread32(sd->base + PACKED_REG_OFFSET);
+            for (i = 0; i < 4; i++, packed >>= 8)
+                ring_put(sd, &head, tail, packed & 0xFF);
+        }
+        while (count--)
+            ring_put(sd, &head, tail, ioread32(sd->base + DATA_REG_OFFSET));
+        status = ioread32(sd->base + STATUS_REG_OFFSET);
+    }
+    serial_stats_irq(&sd->stats, total);
+    trace_rx_drain(total);
+
+    if (head != start) {
+        smp_store_release(&sd->ring_head, head);
+        trace_rx_push(head - start);
+        if (head - tail > sd->high_water)
+            sd->high_water = head - tail;
+        wake_up_interruptible(&sd->rx_wait);
     }
     return IRQ_HANDLED;
 }
 
+// Consumer side: copy up to count bytes out of the ring in at most two
+// chunks (the second one after the wrap); caller holds read_mutex
+static ssize_t ring_get(struct serial_isr_dev *sd, char __user *buffer, size_t count) {
+    unsigned int tail = sd->ring_tail;
+    unsigned int head = smp_load_acquire(&sd->ring_head);
+    unsigned int avail = min_t(size_t, head - tail, count);
+    unsigned int first = min(avail, sd->ring_mask + 1 - (tail & sd->ring_mask));
+
+    if (copy_to_user(buffer, sd->ring + (tail & sd->ring_mask), first) ||
+        copy_to_user(buffer + first, sd->ring, avail - first))
+        return -EFAULT;
+    smp_store_release(&sd->ring_tail, tail + avail);
+    trace_rx_read(avail);
+    return avail;
+}
+
+static bool ring_empty(struct serial_isr_dev *sd) {
+    return smp_load_acquire(&sd->ring_head) == sd->ring_tail;
+}
+
+// misc_open() leaves the miscdevice in private_data
+static struct serial_isr_dev *file_to_serial(struct file *file) {
+    return container_of(file->private_data, struct serial_isr_dev, misc);
+}
+
+// Blocks until the ISR has queued data (unless O_NONBLOCK), then returns
+// everything available up to count
+static ssize_t rx_read(struct file *file, char __user *buffer, size_t count, loff_t *offset) {
+    struct serial_isr_dev *sd = file_to_serial(file);
+    ssize_t result;
+
+    if (count == 0)
+        return 0;
+
+    if (mutex_lock_interruptible(&sd->read_mutex))
+        return -ERESTARTSYS;
+    while (ring_empty(sd) && !READ_ONCE(sd->dead)) {
+        mutex_unlock(&sd->read_mutex);
+        if (file->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(sd->rx_wait, !ring_empty(sd) || READ_ONCE(sd->dead)))
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&sd->read_mutex))
+            return -ERESTARTSYS;
+    }
+    if (READ_ONCE(sd->dead)) {
+        mutex_unlock(&sd->read_mutex);
+        return -ENODEV;
+    }
+    result = ring_get(sd, buffer, count);
+    mutex_unlock(&sd->read_mutex);
+
+    return result;
+}
+
+static __poll_t rx_poll(struct file *file, poll_table *wait) {
+    struct serial_isr_dev *sd = file_to_serial(file);
+
+    poll_wait(file, &sd->rx_wait, wait);
+    if (READ_ONCE(sd->dead))
+        return EPOLLERR | EPOLLHUP;
+    return ring_empty(sd) ? 0 : EPOLLIN | EPOLLRDNORM;
+}
+
+// misc_open() calls this under the misc lock, so misc_deregister() in
+// remove() cannot run between the lookup and taking the reference
+static int rx_open(struct inode *inode, struct file *file) {
+    kref_get(&file_to_serial(file)->ref);
+    return stream_open(inode, file);
+}
+
+static int rx_release(struct inode *inode, struct file *file) {
+    kref_put(&file_to_serial(file)->ref, serial_isr_free);
+    return 0;
+}
+
+static const struct file_operations rx_fops = {
+    .owner = THIS_MODULE,
+    .open = rx_open,
+    .release = rx_release,
+    .read = rx_read,
+    .poll = rx_poll,
+};
+
+// Debug attributes in /sys/bus/platform/devices/<dev>/
 static ssize_t rx_data_show(struct device *dev, struct device_attribute *attr, char *buffer) {
-    if (wr_index == rd_index) {
+    struct serial_isr_dev *sd = dev_get_drvdata(dev);
+    unsigned int tail;
+    char data;
+
+    mutex_lock(&sd->read_mutex);
+    if (ring_empty(sd)) {
+        mutex_unlock(&sd->read_mutex);
         return sprintf(buffer, "-1\n"); // Empty FIFO
     }
-    char data = fifo[rd_index];
-    rd_index = (rd_index + 1) % FIFO_SIZE;
+    tail = sd->ring_tail;
+    data = sd->ring[tail & sd->ring_mask];
+    smp_store_release(&sd->ring_tail, tail + 1);
+    mutex_unlock(&sd->read_mutex);
     return sprintf(buffer, "%c\n", data);
 }
 
-static int probe(struct platform_device* dev) {
-	int result = 0;
-	unsigned int irq;
-	printk(KERN_INFO "serial isr: probe \n");
-	
-	irq = irq_of_parse_and_map(dev->dev.of_node, 0);
-	printk(KERN_INFO "serial isr: found irq = %d in device tree\n", irq);
-	
-	result = request_irq(irq, isr, IRQF_SHARED, "serial ip", &dev->dev);
-	if(result != 0)
-		printk(KERN_INFO "serial iser: request_irq returned %d\n", result);
-	else 
-		printk(KERN_INFO "serial iser: request_irq was successful");
-	
+static ssize_t rx_dropped_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    struct serial_isr_dev *sd = dev_get_drvdata(dev);
+
+    return sprintf(buffer, "%llu\n", sd->stats.ring_drops);
+}
+
+static ssize_t rx_high_water_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    struct serial_isr_dev *sd = dev_get_drvdata(dev);
+
+    return sprintf(buffer, "%u/%u\n", sd->high_water, sd->ring_mask + 1);
+}
+
+static DEVICE_ATTR_RO(rx_data);
+static DEVICE_ATTR_RO(rx_dropped);
+static DEVICE_ATTR_RO(rx_high_water);
+
+static struct attribute *serial_isr_attrs[] = {
+    &dev_attr_rx_data.attr,
+    &dev_attr_rx_dropped.attr,
+    &dev_attr_rx_high_water.attr,
+    NULL
+};
+ATTRIBUTE_GROUPS(serial_isr);
+
+// One /dev/serialip_rxN per serial IP node, with registers and interrupt
+// from the node's reg and interrupts properties
+static int probe(struct platform_device* pdev) {
+	struct serial_isr_dev *sd;
+	int result;
+
+	sd = kzalloc(sizeof(*sd), GFP_KERNEL);
+	if (!sd)
+		return -ENOMEM;
+	kref_init(&sd->ref);
+	mutex_init(&sd->read_mutex);
+	init_waitqueue_head(&sd->rx_wait);
+
+	// Only the ISR and probe/remove touch the registers, so devm is enough
+	sd->base = devm_platform_ioremap_resource(pdev, 0);
+	if (IS_ERR(sd->base)) {
+		result = PTR_ERR(sd->base);
+		goto fail_free;
+	}
+
+	result = platform_get_irq(pdev, 0);
+	if (result < 0)
+		goto fail_free;
+	sd->irq = result;
+
+	sd->ring = kvmalloc(ring_size, GFP_KERNEL);
+	if (!sd->ring) {
+		result = -ENOMEM;
+		goto fail_free;
+	}
+	sd->ring_mask = ring_size - 1;
+
+	sd->id = ida_alloc(&serial_ida, GFP_KERNEL);
+	if (sd->id < 0) {
+		result = sd->id;
+		goto fail_free;
+	}
+	snprintf(sd->name, sizeof(sd->name), "serialip_rx%d", sd->id);
+	platform_set_drvdata(pdev, sd);
+
+	// Interrupt on the trigger level or on a trailing partial burst
+	iowrite32(RXCFG(rx_trigger, rx_timeout), sd->base + RXCFG_REG_OFFSET);
+
+	result = request_irq(sd->irq, isr, IRQF_SHARED, dev_name(&pdev->dev), sd);
+	if (result != 0) {
+		dev_err(&pdev->dev, "request_irq returned %d\n", result);
+		goto fail_id;
+	}
+
+	sd->misc.minor = MISC_DYNAMIC_MINOR;
+	sd->misc.name = sd->name;
+	sd->misc.fops = &rx_fops;
+	sd->misc.parent = &pdev->dev;
+	result = misc_register(&sd->misc);
+	if (result != 0) {
+		dev_err(&pdev->dev, "misc_register returned %d\n", result);
+		goto fail_irq;
+	}
+
+	sd->stats_dir = serial_stats_debugfs(sd->name, stats_root, &sd->stats);
+
+	iowrite32(ioread32(sd->base + CONTROL_REG_OFFSET) | INT_ON_RX_MASK | INT_ON_RX_TIMEOUT_MASK,
+		  sd->base + CONTROL_REG_OFFSET);
+	dev_info(&pdev->dev, "/dev/%s on irq %u\n", sd->name, sd->irq);
+	return 0;
+
+fail_irq:
+	free_irq(sd->irq, sd);
+fail_id:
+	ida_free(&serial_ida, sd->id);
+fail_free:
+	kref_put(&sd->ref, serial_isr_free);
 	return result;
 }
 
-static int remove(struct platform_device* dev) 
+// Files still open keep the instance and its ring; they see it dead and
+// get -ENODEV
+static int remove(struct platform_device* pdev)
 {
-	printk(KERN_INFO "serial isr: remove\n");
-	
-	free_irq(of_irq_get(dev->dev.of_node, 0), &dev->dev);
-	
+	struct serial_isr_dev *sd = platform_get_drvdata(pdev);
+
+	iowrite32(ioread32(sd->base + CONTROL_REG_OFFSET) & ~(INT_ON_RX_MASK | INT_ON_RX_TIMEOUT_MASK),
+		  sd->base + CONTROL_REG_OFFSET);
+	misc_deregister(&sd->misc);
+	free_irq(sd->irq, sd);
+	WRITE_ONCE(sd->dead, true);
+	wake_up_interruptible(&sd->rx_wait);
+	debugfs_remove_recursive(sd->stats_dir);
+	ida_free(&serial_ida, sd->id);
+	kref_put(&sd->ref, serial_isr_free);
+
 	return 0;
 }
 
@@ -90,40 +389,34 @@ static struct platform_driver driver = {
 		.name = "serial isr",
 		.owner = THIS_MODULE,
 		.of_match_table = driver_of_match,
+		.dev_groups = serial_isr_groups,
 	},
 };
 
 static int __init initialize_module(void)
 {
+	ring_size = roundup_pow_of_two(clamp(ring_size, 64u, 1u << 24));
+
+	stats_root = debugfs_create_dir("serial_isr", NULL);
+
 	if(platform_driver_register(&driver)){
 		printk(KERN_WARNING "serial isr: failed to register platform driver\n");
+		debugfs_remove_recursive(stats_root);
 		return -1;
 	}
 	printk(KERN_INFO "serial isr: registered platform driver\n");
-	
-	serial = (uint32_t*)ioremap(serial + SERIAL_BASE_OFFSET, SPAN_IN_BYTES);
-	if(serial == NULL){
-		printk(KERN_WARNING "serial isr: ioremap failed\n");
-		return -EIO;
-	}
-	printk(KERN_INFO "serial isr: ioremap returned 0x%p\n", serial);
-	printk(KERN_INFO "serial isr: initialize done\n");
-	
-	return 0;	
+
+	return 0;
 }
 
 
 static void __exit exit_module(void)
 {
 	platform_driver_unregister(&driver);
+	debugfs_remove_recursive(stats_root);
+	ida_destroy(&serial_ida);
 	printk(KERN_INFO "serial isr: exit\n");
 }
 
 module_init(initialize_module);
 module_exit(exit_module);
-
-
-
-	
-	
-	
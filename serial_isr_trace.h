@@ -0,0 +1,69 @@
+// Serial IP ISR Tracepoints
+// Olajumoke Aboderin
+
+// Events in /sys/kernel/tracing/events/serial_isr/, for measuring the
+// IRQ to reader latency:
+//   irq_entry    status register at interrupt entry
+//   rx_drain     bytes read from the RX FIFO by the ISR
+//   rx_push      bytes published to the ring (readers are woken here)
+//   rx_read      bytes copied out to a reader of /dev/serialip_rxN
+// Disabled tracepoints are a patched-out branch, so they cost nothing
+// until enabled; serial_trace_hist.py turns a capture into histograms
+//
+// The module build needs this directory on the include path:
+//   CFLAGS_serial_isr.o := -I$(src)
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM serial_isr
+
+#if !defined(SERIAL_ISR_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define SERIAL_ISR_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(irq_entry,
+	TP_PROTO(u32 status),
+	TP_ARGS(status),
+	TP_STRUCT__entry(
+		__field(u32, status)
+	),
+	TP_fast_assign(
+		__entry->status = status;
+	),
+	TP_printk("status=0x%08x", __entry->status)
+);
+
+DECLARE_EVENT_CLASS(serial_isr_count,
+	TP_PROTO(unsigned int count),
+	TP_ARGS(count),
+	TP_STRUCT__entry(
+		__field(unsigned int, count)
+	),
+	TP_fast_assign(
+		__entry->count = count;
+	),
+	TP_printk("count=%u", __entry->count)
+);
+
+DEFINE_EVENT(serial_isr_count, rx_drain,
+	TP_PROTO(unsigned int count),
+	TP_ARGS(count)
+);
+
+DEFINE_EVENT(serial_isr_count, rx_push,
+	TP_PROTO(unsigned int count),
+	TP_ARGS(count)
+);
+
+DEFINE_EVENT(serial_isr_count, rx_read,
+	TP_PROTO(unsigned int count),
+	TP_ARGS(count)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE serial_isr_trace
+#include <trace/define_trace.h>
@@ -22,26 +22,121 @@
 #define QE_REGS_H_
 
 #define CLK_FREQ 100000000 
-#define SPAN_IN_BYTES 32
+#define SPAN_IN_BYTES 64
 #define SERIAL_BASE_OFFSET 0x20000
 #define DATA_REG_OFFSET    0
 #define STATUS_REG_OFFSET  1
 #define CONTROL_REG_OFFSET 2
 #define BRD_REG_OFFSET     3
+#define CAP_REG_OFFSET     4
+#define LEVEL_REG_OFFSET   5
+#define RXCFG_REG_OFFSET   6
+#define PACKED_REG_OFFSET  7
+#define RXD_REG_OFFSET     8
+#define TXCFG_REG_OFFSET   9
+#define IMOD_REG_OFFSET    10
+#define FLOW_REG_OFFSET    11
+#define IPEND_REG_OFFSET   15
+
+// Multi-channel IP: channel n's registers start at word n * CHANNEL_SPAN_WORDS
+// (SPAN_IN_BYTES each); IPEND reads the same in every channel's window
+#define MAX_CHANNELS       16
+#define CHANNEL_SPAN_WORDS (SPAN_IN_BYTES / 4)
 
 // Status register bit masks
+#define RXFF (1 << 0)
 #define RXFE (1 << 1)
+#define RXOV (1 << 2)
+#define TXFF (1 << 3)
 #define TXFE (1 << 4)
+#define TXOV (1 << 5)
+#define FRAME_ERR  (1 << 6)
+#define PARITY_ERR (1 << 7)
+#define RXTRIG (1 << 13)
+#define RXTO   (1 << 14)
+#define RXERR  (1 << 15)
+#define NOISE_ERR (1 << 24)
+#define TXLOW  (1 << 25)    // TX FIFO at or below the TXCFG low watermark
+#define CTS    (1 << 26)    // CTS input asserted
+#define RTS    (1 << 27)    // RTS output asserted
+
+// Status register FIFO watermarks (entries currently in each FIFO)
+// These saturate at WATERMARK_MASK; use the level register for deeper FIFOs
+#define RX_WATERMARK_SHIFT 8
+#define TX_WATERMARK_SHIFT 16
+#define WATERMARK_MASK     0x1F
+#define RX_WATERMARK(status) (((status) >> RX_WATERMARK_SHIFT) & WATERMARK_MASK)
+#define TX_WATERMARK(status) (((status) >> TX_WATERMARK_SHIFT) & WATERMARK_MASK)
+
+// Bytes returned by the last packed data register read (0 to 4)
+#define PACKED_COUNT(status) (((status) >> 21) & 0x07)
+
+// RXD register fields (one RX FIFO entry with its error flags)
+#define RXD_DATA_MASK 0xFF
+#define RXD_VALID     (1 << 8)
+#define RXD_FE        (1 << 9)
+#define RXD_PE        (1 << 10)
+#define RXD_BRK       (1 << 11)
+#define RXD_NOISE     (1 << 12)     // samples disagreed; the byte is still valid
+#define RXD_REMAINING(rxd) (((rxd) >> 16) & 0xFFFF)
+
+// Capability register fields (log2 of the FIFO depths)
+#define CAP_RX_DEPTH(cap) (1u << ((cap) & 0x0F))
+#define CAP_TX_DEPTH(cap) (1u << (((cap) >> 4) & 0x0F))
+#define CAP_CHANNELS(cap) ((((cap) >> 8) & 0x0F) + 1)
+#define CAP_CHANNEL(cap)  (((cap) >> 12) & 0x0F)
+
+// Level register fields (exact FIFO entry counts)
+#define LEVEL_RX(level) ((level) & 0xFFFF)
+#define LEVEL_TX(level) (((level) >> 16) & 0xFFFF)
 
 // Control register bit masks
 #define ENABLE_MASK (1 << 4)
 #define TEST_MASK 	(1 << 5)
+#define INT_ON_RX_MASK (1 << 6)
+#define INT_ON_TX_MASK (1 << 7)
+#define INT_ON_RX_TIMEOUT_MASK (1 << 9)
+#define TX_DMA_MASK (1 << 10)
+#define RX_DMA_MASK (1 << 11)
+#define LOOPBACK_MASK (1 << 12)
+#define OSR_OFFSET 13
+#define OSR_MASK (0x3 << OSR_OFFSET)
+#define INT_ON_TX_LOW_MASK (1 << 15)
+#define RTS_MASK (1 << 16)
+#define AUTO_FLOW_MASK (1 << 17)    // RTS drops at the FLOW level, CTS gates TX
 #define DATA_LENGTH_MASK   0x03  
 #define PARITY_MODE_MASK   0x0C  
 #define STOP_BITS_MASK     0x100  
 
+// RX config register fields
+#define RX_TRIGGER_MASK    0xFFFF
+#define RX_TIMEOUT_OFFSET  16
+#define RX_TIMEOUT_MASK    0xFF
+#define RXCFG(trigger, timeout) (((trigger) & RX_TRIGGER_MASK) | \
+                                 (((timeout) & RX_TIMEOUT_MASK) << RX_TIMEOUT_OFFSET))
+
+// TX config register: TX low watermark in entries
+#define TX_LOW_MASK        0xFFFF
+
+// Interrupt moderation register: minimum spacing between interrupt
+// assertions in microseconds (0 = off)
+#define IMOD_US_MASK       0xFFFF
+
+// Flow control register: RX FIFO entries at which auto flow drops RTS
+// (0 = FIFO full)
+#define FLOW_RTS_MASK      0xFFFF
+
+// Interrupt pending register: bit n set while channel n requests an interrupt
+#define IPEND(channel)     (1u << (channel))
+
 // BRD register bit masks
 #define IBRD_OFFSET		8
 #define FBRD_MASK 		0xFF  
 
+// Oversampling field values (baud ticks per bit); see serial_baud.h
+#define OSR_16X 0
+#define OSR_8X  1
+#define OSR_4X  2
+#define OSR_TICKS(osr) (16u >> (osr))
+
 #endif
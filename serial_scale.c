@@ -0,0 +1,387 @@
+// Serial IP Multi-Port Scaling Benchmark
+// Olajumoke Aboderin
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Xilinx XUP Blackboard
+
+// Hardware configuration:
+//
+// Several serial IP instances or channels, each bound by serial_tty_driver as
+// its own /dev/ttyserialN (see serial_ports.dtsi)
+
+// Runs loopback traffic on 1, 2, ... N ports at once, one thread per port,
+// to show how aggregate throughput and CPU cost scale with the port count.
+// Each port is put in internal loopback with TIOCMBIS TIOCM_LOOP and streams
+// a counting pattern back to itself for the step duration. For each step it
+// reports, per port and in total:
+//   - bytes/s received and checked
+//   - interrupts/s, from /sys/class/tty/ttyserialN/device/irq_count (the
+//     channels of a multi-channel IP share it; the total counts it once)
+//   - the CPU the port's IRQ is pinned to (irq_cpu next to irq_count)
+//   - framing/parity/overflow errors from /proc/tty/driver/ttyserial and
+//     pattern mismatches
+//   - system CPU utilization over the step, from /proc/stat (total row)
+// Results are printed as CSV on stdout
+//
+// Build:
+//   gcc -O2 -pthread serial_scale.c -o serial_scale
+// Example:
+//   ./serial_scale -b 921600 -d 5 > scale.csv
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#define MAX_PORTS       16
+#define DEFAULT_BAUD    921600
+#define DEFAULT_SECONDS 5
+#define CHUNK           1024
+#define MAX_IN_FLIGHT   4096
+#define TTY_NAME        "/dev/ttyserial"
+#define SYS_TTY         "/sys/class/tty/ttyserial"
+#define PROC_TTY        "/proc/tty/driver/ttyserial"
+
+// Modem line bit for loopback (asm-generic/termios.h); glibc leaves it out
+#ifndef TIOCM_LOOP
+#define TIOCM_LOOP      0x8000
+#endif
+
+// Per-port state; counters are written by the port's thread only
+typedef struct {
+	unsigned int line;
+	int fd;
+	pthread_t thread;
+	uint64_t sent;
+	uint64_t received;
+	uint64_t mismatches;
+	uint64_t irqs;
+	uint64_t errors;
+	int irq_cpu;
+} portState;
+
+// Aggregate CPU time from the first line of /proc/stat
+typedef struct {
+	unsigned long long busy;
+	unsigned long long total;
+} cpuTimes;
+
+portState ports[MAX_PORTS];
+volatile bool running = false;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static speed_t baudToSpeed(uint32_t baud) {
+	switch (baud) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 500000: return B500000;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	case 1500000: return B1500000;
+	case 2000000: return B2000000;
+	case 3000000: return B3000000;
+	default: return B0;
+	}
+}
+
+static void readCpu(cpuTimes *cpu) {
+	unsigned long long user = 0, nice = 0, system = 0, idle = 0;
+	unsigned long long iowait = 0, irq = 0, softirq = 0, steal = 0;
+	FILE *file = fopen("/proc/stat", "r");
+
+	memset(cpu, 0, sizeof(*cpu));
+	if (!file)
+		return;
+	if (fscanf(file, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+	           &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) >= 4) {
+		cpu->busy = user + nice + system + irq + softirq + steal;
+		cpu->total = cpu->busy + idle + iowait;
+	}
+	fclose(file);
+}
+
+// Single number from /sys/class/tty/ttyserialN/device/<attr>
+static long long readAttr(unsigned int line, const char *attr) {
+	char path[128];
+	long long value = -1;
+	FILE *file;
+
+	snprintf(path, sizeof(path), SYS_TTY "%u/device/%s", line, attr);
+	file = fopen(path, "r");
+	if (!file)
+		return -1;
+	if (fscanf(file, "%lld", &value) != 1)
+		value = -1;
+	fclose(file);
+	return value;
+}
+
+// True when two lines are channels of the same IP (same device directory)
+static bool sameDevice(unsigned int a, unsigned int b) {
+	char path[128], real_a[PATH_MAX], real_b[PATH_MAX];
+
+	snprintf(path, sizeof(path), SYS_TTY "%u/device", a);
+	if (!realpath(path, real_a))
+		return false;
+	snprintf(path, sizeof(path), SYS_TTY "%u/device", b);
+	if (!realpath(path, real_b))
+		return false;
+	return strcmp(real_a, real_b) == 0;
+}
+
+// Frame, parity and overflow errors of one line in /proc/tty/driver/ttyserial
+static uint64_t readErrors(unsigned int line) {
+	unsigned long long total = 0;
+	char text[512];
+	char *p;
+	FILE *file = fopen(PROC_TTY, "r");
+
+	if (!file)
+		return 0;
+	while (fgets(text, sizeof(text), file)) {
+		if (strtoul(text, &p, 10) != line || *p != ':')
+			continue;
+		if ((p = strstr(text, " fe:")))
+			total += strtoull(p + 4, NULL, 10);
+		if ((p = strstr(text, " pe:")))
+			total += strtoull(p + 4, NULL, 10);
+		if ((p = strstr(text, " oe:")))
+			total += strtoull(p + 4, NULL, 10);
+	}
+	fclose(file);
+	return total;
+}
+
+// Raw, non-blocking TTY in internal loopback
+static int openPort(unsigned int line, uint32_t baud) {
+	struct termios tio;
+	char path[64];
+	int loop = TIOCM_LOOP;
+	int fd;
+
+	snprintf(path, sizeof(path), TTY_NAME "%u", line);
+	fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+		return -1;
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 0;
+		cfsetspeed(&tio, baudToSpeed(baud));
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	ioctl(fd, TIOCMBIS, &loop);
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+}
+
+static void closePort(int fd) {
+	int loop = TIOCM_LOOP;
+
+	ioctl(fd, TIOCMBIC, &loop);
+	close(fd);
+}
+
+// Stream a counting pattern and check it on the way back, keeping at most
+// MAX_IN_FLIGHT bytes outstanding so the RX side never overflows
+static void *portThread(void *arg) {
+	portState *port = arg;
+	uint8_t tx[CHUNK], rx[CHUNK];
+	uint8_t next_tx = 0, next_rx = 0;
+	struct pollfd pfd = { .fd = port->fd };
+	size_t room;
+	ssize_t n, i;
+
+	while (running) {
+		room = MAX_IN_FLIGHT - (size_t)(port->sent - port->received);
+		pfd.events = POLLIN | (room ? POLLOUT : 0);
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+
+		if ((pfd.revents & POLLOUT) && room) {
+			if (room > CHUNK)
+				room = CHUNK;
+			for (i = 0; i < (ssize_t)room; i++)
+				tx[i] = next_tx + i;
+			n = write(port->fd, tx, room);
+			if (n > 0) {
+				next_tx += n;
+				port->sent += n;
+			}
+		}
+		if (pfd.revents & POLLIN) {
+			n = read(port->fd, rx, sizeof(rx));
+			for (i = 0; i < n; i++) {
+				if (rx[i] != next_rx)
+					port->mismatches++;
+				next_rx = rx[i] + 1;
+			}
+			if (n > 0)
+				port->received += n;
+		}
+	}
+	return NULL;
+}
+
+// Count consecutive ports from ttyserial0 that exist
+static unsigned int findPorts(void) {
+	char path[64];
+	unsigned int count;
+
+	for (count = 0; count < MAX_PORTS; count++) {
+		snprintf(path, sizeof(path), TTY_NAME "%u", count);
+		if (access(path, R_OK | W_OK) != 0)
+			break;
+	}
+	return count;
+}
+
+// Run traffic on the first n ports for the given time and print the rows
+static int runStep(unsigned int n, uint32_t baud, double seconds) {
+	uint64_t irqs[MAX_PORTS], errors[MAX_PORTS];
+	uint64_t total_bytes = 0, total_irqs = 0, total_errors = 0, total_mismatches = 0;
+	cpuTimes cpu_start, cpu_end;
+	double start, elapsed, cpu_pct;
+	unsigned int i, j;
+
+	for (i = 0; i < n; i++) {
+		memset(&ports[i], 0, sizeof(ports[i]));
+		ports[i].line = i;
+		ports[i].fd = openPort(i, baud);
+		if (ports[i].fd < 0) {
+			fprintf(stderr, "Cannot open " TTY_NAME "%u: %s\n", i, strerror(errno));
+			while (i--)
+				closePort(ports[i].fd);
+			return -1;
+		}
+		ports[i].irq_cpu = readAttr(i, "irq_cpu");
+		irqs[i] = readAttr(i, "irq_count");
+		errors[i] = readErrors(i);
+	}
+
+	running = true;
+	readCpu(&cpu_start);
+	start = now();
+	for (i = 0; i < n; i++)
+		pthread_create(&ports[i].thread, NULL, portThread, &ports[i]);
+	usleep((useconds_t)(seconds * 1e6));
+	running = false;
+	for (i = 0; i < n; i++)
+		pthread_join(ports[i].thread, NULL);
+	elapsed = now() - start;
+	readCpu(&cpu_end);
+
+	for (i = 0; i < n; i++) {
+		portState *port = &ports[i];
+
+		port->irqs = readAttr(i, "irq_count") - irqs[i];
+		port->errors = readErrors(i) - errors[i];
+		closePort(port->fd);
+		printf("%u,%u,%d,%llu,%.3f,%.0f,%.0f,%.2f,,%llu,%llu\n",
+		       n, i, port->irq_cpu, (unsigned long long)port->received, elapsed,
+		       port->received / elapsed, port->irqs / elapsed,
+		       port->irqs ? (double)port->received / port->irqs : 0.0,
+		       (unsigned long long)port->errors, (unsigned long long)port->mismatches);
+		total_bytes += port->received;
+		for (j = 0; j < i && !sameDevice(i, j); j++)
+			;
+		if (j == i)
+			total_irqs += port->irqs;
+		total_errors += port->errors;
+		total_mismatches += port->mismatches;
+	}
+
+	cpu_pct = cpu_end.total > cpu_start.total ?
+	          100.0 * (cpu_end.busy - cpu_start.busy) / (cpu_end.total - cpu_start.total) : 0.0;
+	printf("%u,all,,%llu,%.3f,%.0f,%.0f,%.2f,%.1f,%llu,%llu\n",
+	       n, (unsigned long long)total_bytes, elapsed, total_bytes / elapsed,
+	       total_irqs / elapsed, total_irqs ? (double)total_bytes / total_irqs : 0.0,
+	       cpu_pct, (unsigned long long)total_errors, (unsigned long long)total_mismatches);
+	fflush(stdout);
+	return 0;
+}
+
+static void printUsage(void) {
+	printf("Usage: ./serial_scale [options]\n");
+	printf("  -b baud     line rate on every port (default %d)\n", DEFAULT_BAUD);
+	printf("  -d seconds  duration of each step (default %d)\n", DEFAULT_SECONDS);
+	printf("  -n ports    largest port count (default all /dev/ttyserialN found)\n");
+	printf("Steps run 1, 2, ... ports, always starting from ttyserial0\n");
+	printf("CSV columns: ports,port,irq_cpu,bytes,seconds,bytes_per_s,irqs_per_s,\n");
+	printf("  bytes_per_irq,cpu_pct,errors,mismatches (port \"all\" is the total)\n");
+}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	uint32_t baud = DEFAULT_BAUD;
+	double seconds = DEFAULT_SECONDS;
+	unsigned int nports = findPorts(), max = 0, n;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:d:n:h")) != -1) {
+		switch (opt) {
+		case 'b': baud = strtoul(optarg, NULL, 0); break;
+		case 'd': seconds = strtod(optarg, NULL); break;
+		case 'n': max = strtoul(optarg, NULL, 0); break;
+		default:
+			printUsage();
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (baudToSpeed(baud) == B0) {
+		fprintf(stderr, "Unsupported baud rate %u\n", baud);
+		return EXIT_FAILURE;
+	}
+	if (max && max < nports)
+		nports = max;
+	if (nports == 0) {
+		fprintf(stderr, "No " TTY_NAME "N ports found\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("ports,port,irq_cpu,bytes,seconds,bytes_per_s,irqs_per_s,bytes_per_irq,"
+	       "cpu_pct,errors,mismatches\n");
+	for (n = 1; n <= nports; n++)
+		if (runStep(n, baud, seconds) < 0)
+			return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+// Serial IP Driver Statistics
+// Olajumoke Aboderin
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Xilinx XUP Blackboard
+
+// Per-port counters shared by the serial kernel modules
+// Counters are plain u64s, each bumped from a single context (the ISR or
+// a path already under the driver's own lock), so the hot path takes no
+// extra locks and the counters can stay on in production
+//
+// Each driver exports them in /sys/kernel/debug/<driver>/stats (the TTY
+// driver has one directory per port); reading dumps the counters and
+// writing anything resets them:
+//   cat /sys/kernel/debug/serial_tty/ttyserial0/stats
+//   echo 0 > /sys/kernel/debug/serial_tty/ttyserial0/stats
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef SERIAL_STATS_H_
+#define SERIAL_STATS_H_
+
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/fs.h>
+#include <linux/string.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include "serial_regs.h"
+
+// Bytes per interrupt histogram: bucket 0 counts interrupts that moved no
+// RX data, bucket n counts 2^(n-1) to 2^n - 1 bytes, the last is open ended
+#define SERIAL_STATS_BUCKETS 10
+
+// Sticky status flags counted (and cleared) by serial_stats_status()
+#define SERIAL_STATS_STICKY (RXOV | TXOV | FRAME_ERR | PARITY_ERR | NOISE_ERR)
+
+struct serial_stats {
+    u64 rx_bytes;
+    u64 tx_bytes;
+    u64 irqs;
+    u64 rx_per_irq[SERIAL_STATS_BUCKETS];
+    u64 rx_fifo_overflow;
+    u64 tx_fifo_overflow;
+    u64 frame_errors;
+    u64 parity_errors;
+    u64 noise_errors;
+    u64 ring_drops;
+    u64 tx_stall_ns;
+    ktime_t tx_stall_start;     // 0 while TX is not stalled
+};
+
+// One interrupt whose rx bytes are already in rx_bytes (added as they were
+// drained, e.g. by a polling thread): count it and its histogram bucket
+static inline void serial_stats_irq_done(struct serial_stats *s, unsigned int rx) {
+    unsigned int bucket = rx ? min(ilog2(rx) + 1, SERIAL_STATS_BUCKETS - 1) : 0;
+
+    s->irqs++;
+    s->rx_per_irq[bucket]++;
+}
+
+// One interrupt that moved rx bytes
+static inline void serial_stats_irq(struct serial_stats *s, unsigned int rx) {
+    s->rx_bytes += rx;
+    serial_stats_irq_done(s, rx);
+}
+
+// Count the sticky error flags in a status word and return them, so the
+// caller can clear exactly those (write 1 to clear); each flag counts once
+// per clear, so bursts of errors between interrupts count as one
+static inline uint32_t serial_stats_status(struct serial_stats *s, uint32_t status) {
+    uint32_t sticky = status & SERIAL_STATS_STICKY;
+
+    if (sticky & RXOV)
+        s->rx_fifo_overflow++;
+    if (sticky & TXOV)
+        s->tx_fifo_overflow++;
+    if (sticky & FRAME_ERR)
+        s->frame_errors++;
+    if (sticky & PARITY_ERR)
+        s->parity_errors++;
+    if (sticky & NOISE_ERR)
+        s->noise_errors++;
+    return sticky;
+}
+
+// TX stall time: from the moment a writer finds no room until room opens up
+static inline void serial_stats_tx_stall_begin(struct serial_stats *s) {
+    if (!s->tx_stall_start)
+        s->tx_stall_start = ktime_get();
+}
+
+static inline void serial_stats_tx_stall_end(struct serial_stats *s) {
+    if (s->tx_stall_start) {
+        s->tx_stall_ns += ktime_to_ns(ktime_sub(ktime_get(), s->tx_stall_start));
+        s->tx_stall_start = 0;
+    }
+}
+
+// One line summary in the style of /proc/tty/driver/<driver>
+static inline void serial_stats_proc_line(struct seq_file *m, const struct serial_stats *s) {
+    seq_printf(m, " tx:%llu rx:%llu fe:%llu pe:%llu oe:%llu drop:%llu",
+               s->tx_bytes, s->rx_bytes, s->frame_errors, s->parity_errors,
+               s->rx_fifo_overflow, s->ring_drops);
+}
+
+static inline int serial_stats_show(struct seq_file *m, void *v) {
+    const struct serial_stats *s = m->private;
+    unsigned int i;
+
+    seq_printf(m, "rx_bytes %llu\n", s->rx_bytes);
+    seq_printf(m, "tx_bytes %llu\n", s->tx_bytes);
+    seq_printf(m, "irqs %llu\n", s->irqs);
+    seq_printf(m, "rx_fifo_overflow %llu\n", s->rx_fifo_overflow);
+    seq_printf(m, "tx_fifo_overflow %llu\n", s->tx_fifo_overflow);
+    seq_printf(m, "frame_errors %llu\n", s->frame_errors);
+    seq_printf(m, "parity_errors %llu\n", s->parity_errors);
+    seq_printf(m, "noise_errors %llu\n", s->noise_errors);
+    seq_printf(m, "ring_drops %llu\n", s->ring_drops);
+    seq_printf(m, "tx_stall_us %llu\n", div_u64(s->tx_stall_ns, 1000));
+    seq_puts(m, "rx_bytes_per_irq\n");
+    seq_printf(m, "  0 %llu\n", s->rx_per_irq[0]);
+    for (i = 1; i < SERIAL_STATS_BUCKETS - 1; i++)
+        seq_printf(m, "  %u-%u %llu\n", 1u << (i - 1), (1u << i) - 1, s->rx_per_irq[i]);
+    seq_printf(m, "  %u+ %llu\n", 1u << (i - 1), s->rx_per_irq[i]);
+    return 0;
+}
+
+static inline int serial_stats_open(struct inode *inode, struct file *file) {
+    return single_open(file, serial_stats_show, inode->i_private);
+}
+
+static inline ssize_t serial_stats_write(struct file *file, const char __user *buffer,
+                                         size_t count, loff_t *offset) {
+    struct serial_stats *s = ((struct seq_file *)file->private_data)->private;
+
+    memset(s, 0, sizeof(*s));
+    return count;
+}
+
+static const struct file_operations serial_stats_fops = {
+    .owner = THIS_MODULE,
+    .open = serial_stats_open,
+    .read = seq_read,
+    .write = serial_stats_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+// Creates <parent>/<name>/stats under /sys/kernel/debug (parent NULL for the
+// debugfs root); remove with debugfs_remove_recursive()
+static inline struct dentry *serial_stats_debugfs(const char *name, struct dentry *parent,
+                                                  struct serial_stats *s) {
+    struct dentry *dir = debugfs_create_dir(name, parent);
+
+    debugfs_create_file("stats", 0644, dir, s, &serial_stats_fops);
+    return dir;
+}
+
+#endif
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+# Serial IP Trace Latency Histograms
+# Olajumoke Aboderin
+
+# Builds latency histograms from a capture of the serial_tty or serial_isr
+# tracepoints (see serial_tty_trace.h and serial_isr_trace.h)
+#
+#   echo 1 > /sys/kernel/tracing/events/serial_tty/enable
+#   ... run the load ...
+#   cat /sys/kernel/tracing/trace > serial.trace
+#   echo 0 > /sys/kernel/tracing/events/serial_tty/enable
+#   python3 serial_trace_hist.py serial.trace
+#
+# trace-cmd report output works as well; use - to read stdin
+#
+# Latencies reported:
+#   irq -> push     irq_entry to the next rx_push on the same CPU (or the
+#                   latest irq_entry when the push runs elsewhere, as in
+#                   rx_poll mode)
+#   write -> fifo   tx_write to the tx_enqueue that moves its first byte
+#                   into the hardware FIFO, counting the bytes queued ahead
+#                   of it; flushed writes never complete and are skipped
+#   push -> read    rx_push to the first rx_read that takes its bytes
+#                   (serial_isr only)
+
+import re
+import sys
+from collections import deque
+
+LINE = re.compile(r'^\s*(?P<task>.+?)-(?P<pid>\d+)\s+(?:\(.*?\)\s+)?\[(?P<cpu>\d+)\]'
+                  r'\s+(?:\S+\s+)?(?P<ts>\d+\.\d+):\s+(?P<event>\w+):\s*(?P<args>.*)$')
+ARG = re.compile(r'(\w+)=(\S+)')
+
+
+def parse(stream):
+    for line in stream:
+        m = LINE.match(line)
+        if not m:
+            continue
+        args = {k: int(v, 0) for k, v in ARG.findall(m.group('args'))}
+        yield float(m.group('ts')), int(m.group('cpu')), m.group('event'), args
+
+
+def analyse(events):
+    irq_push, write_fifo, push_read = [], [], []
+    irq_by_cpu, last_irq = {}, None
+    writes = []             # [timestamp, bytes still to enqueue before its first byte]
+    pushes = deque()        # [timestamp, bytes not yet read]
+    drained = 0
+
+    for ts, cpu, event, args in events:
+        if event == 'irq_entry':
+            irq_by_cpu[cpu] = ts
+            last_irq = ts
+        elif event == 'rx_drain':
+            drained += args.get('count', 0)
+        elif event == 'rx_push':
+            start = irq_by_cpu.pop(cpu, None)
+            if start is None:
+                start, last_irq = last_irq, None
+            if start is not None:
+                irq_push.append(ts - start)
+            pushes.append([ts, args.get('count', 0)])
+        elif event == 'rx_read':
+            count = args.get('count', 0)
+            if pushes:
+                push_read.append(ts - pushes[0][0])
+            while count and pushes:
+                take = min(count, pushes[0][1])
+                pushes[0][1] -= take
+                count -= take
+                if pushes[0][1] == 0:
+                    pushes.popleft()
+        elif event == 'tx_write':
+            writes.append([ts, args.get('queued', 0) + 1])
+        elif event == 'tx_enqueue':
+            count = args.get('count', 0)
+            pending = []
+            for write in writes:
+                write[1] -= count
+                if write[1] <= 0:
+                    write_fifo.append(ts - write[0])
+                else:
+                    pending.append(write)
+            writes = pending
+
+    return irq_push, write_fifo, push_read, drained, len(writes)
+
+
+def percentile(values, p):
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+# log2 buckets in microseconds
+def histogram(name, seconds):
+    if not seconds:
+        return
+    us = sorted(s * 1e6 for s in seconds)
+    print('%s: %d samples, min %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us'
+          % (name, len(us), us[0], percentile(us, 50), percentile(us, 99), us[-1]))
+    buckets = {}
+    for value in us:
+        bucket = 0
+        while (1 << bucket) <= value:
+            bucket += 1
+        buckets[bucket] = buckets.get(bucket, 0) + 1
+    peak = max(buckets.values())
+    for bucket in range(min(buckets), max(buckets) + 1):
+        count = buckets.get(bucket, 0)
+        low = 0 if bucket == 0 else 1 << (bucket - 1)
+        print('  %7d - %-7d us %8d %s' % (low, 1 << bucket, count, '#' * (count * 50 // peak)))
+    print()
+
+
+def main():
+    if len(sys.argv) != 2:
+        print('usage: serial_trace_hist.py trace_file|-', file=sys.stderr)
+        return 1
+    stream = sys.stdin if sys.argv[1] == '-' else open(sys.argv[1])
+    irq_push, write_fifo, push_read, drained, unmatched = analyse(parse(stream))
+
+    histogram('irq -> push', irq_push)
+    histogram('write -> fifo', write_fifo)
+    histogram('push -> read', push_read)
+    print('%d bytes drained, %d writes never reached the FIFO' % (drained, unmatched))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
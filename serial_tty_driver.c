@@ -7,29 +7,131 @@
 #include <linux/platform_device.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
-#include <linux/of_irq.h>
 #include <linux/types.h>
 #include <linux/tty.h>
 #include <linux/tty_flip.h>
+#include <linux/kfifo.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/idr.h>
+#include <linux/cpumask.h>
+#include <linux/bitops.h>
+#include <linux/sched/signal.h>
+#include <linux/jiffies.h>
+#include <linux/delay.h>
 #include <linux/io.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
 #include <asm/io.h>
-#include "../address_map.h"
+#include <asm/unaligned.h>
 #include "serial_regs.h"
+#include "serial_stats.h"
+#include "serial_baud.h"
+
+#define CREATE_TRACE_POINTS
+#include "serial_tty_trace.h"
 
 #define DEVICE_NAME "ttyserial"
-#define TTY_BUFFER_SIZE 1024
 
-// Status register masks
-#define STATUS_RX_EMPTY_MASK (1 << 1)
-#define STATUS_TX_FULL_MASK (1 << 4)
+// Serial channels this driver can bind, one ttyserialN each
+#define SERIAL_MAX_PORTS 32
+
+// Software TX ring (must be a power of 2)
+#define TX_RING_SIZE 4096
+// Wake up writers once the ring drains below this many bytes
+#define TX_WAKEUP_CHARS 256
+
+// RX trigger level and RX timeout interrupts
+#define RX_INT_MASKS (INT_ON_RX_MASK | INT_ON_RX_TIMEOUT_MASK)
+
+// DMA buffers: RX is a cyclic buffer split into periods, TX is a bounce
+// buffer filled from the TX ring (module data is not DMA-able)
+#define RX_DMA_PERIODS    4
+#define RX_DMA_PERIOD_LEN 1024
+#define RX_DMA_BUF_SIZE   (RX_DMA_PERIODS * RX_DMA_PERIOD_LEN)
+#define TX_DMA_BUF_SIZE   1024
+
+
+struct serialip_block;
+
+// Per-port state, one per serial channel
+// The structure lives as long as its tty_port: remove() drops the probe
+// reference and an open tty keeps it until the last close
+struct serialip_port {
+    struct tty_port port;
+    struct device *dev;
+    struct serialip_block *blk;
+    uint32_t __iomem *base;         // this channel's register window
+    resource_size_t phys;
+    unsigned int channel;
+    unsigned int line;
+
+    // Hardware FIFO depths from the capability register
+    unsigned int rx_fifo_depth;
+    unsigned int tx_fifo_depth;
+    unsigned char *rx_buf;
+    unsigned char *tx_buf;
+
+    // TX state and control register updates, protected by tx_lock (shared with the ISR)
+    spinlock_t tx_lock;
+    DECLARE_KFIFO(tx_ring, unsigned char, TX_RING_SIZE);
+    bool tx_int_enabled;
+    bool tx_stopped;
+    bool rx_active;
 
+    // rx_poll mode: RX interrupt masked and the FIFO polled by the IRQ thread
+    bool rx_polling;
+    unsigned int rx_idle;
+    unsigned int rx_poll_bytes;     // drained since the interrupt that started polling
 
+    // DMA channels from the device tree; NULL when absent and PIO is used
+    // tx_dma_* state is protected by tx_lock, rx_dma_tail by rx_dma_lock
+    struct dma_chan *dma_rx;
+    struct dma_chan *dma_tx;
+    unsigned char *rx_dma_buf;
+    unsigned char *tx_dma_buf;
+    dma_addr_t rx_dma_addr;
+    dma_addr_t tx_dma_addr;
+    dma_cookie_t rx_dma_cookie;
+    unsigned int rx_dma_tail;
+    unsigned int tx_dma_len;
+    bool rx_dma_active;
+    bool tx_dma_active;
+    bool tx_dma_busy;
+    spinlock_t rx_dma_lock;
 
+    // Port statistics (debugfs serial_tty/ttyserialN/stats and
+    // /proc/tty/driver/ttyserial)
+    struct serial_stats stats;
+    struct dentry *stats_dir;
+};
+
+// Per-IP state, one per serial IP node in the device tree: the register
+// block, the one interrupt line and the channels behind them
+// Multi-channel IPs report their channel count in CAP[11:8]; the handler
+// reads the interrupt pending register once and services only the channels
+// whose bit is set
+struct serialip_block {
+    struct device *dev;
+    uint32_t __iomem *base;
+    resource_size_t phys;
+    unsigned int irq;
+    int irq_cpu;                    // CPU the IRQ is pinned to, -1 for none
+    u64 irqs;
+    unsigned int nports;
+    struct serialip_port *ports[MAX_CHANNELS];
+};
 
 // Globals
-static uint32_t *base = NULL;
 static struct tty_driver *serial_tty_driver;
-static struct tty_port serial_tty_port;
+static struct dentry *stats_root = NULL;
+
+// Bound ports by line; ports_lock covers the table and line allocation
+static struct serialip_port *ports[SERIAL_MAX_PORTS];
+static DEFINE_MUTEX(ports_lock);
+static DEFINE_IDA(port_ida);
 
 
 
@@ -37,87 +139,1217 @@ MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Olajumoke Aboderin");
 MODULE_DESCRIPTION("Serial TTY Driver");
 
+// RX interrupt moderation: interrupt once rx_trigger bytes are waiting, or
+// after rx_timeout character times of silence with a partial burst queued
+static unsigned int rx_trigger = 0;
+module_param(rx_trigger, uint, 0644);
+MODULE_PARM_DESC(rx_trigger, "RX FIFO trigger level in bytes (0 = half the FIFO)");
+
+static unsigned int rx_timeout = 4;
+module_param(rx_timeout, uint, 0644);
+MODULE_PARM_DESC(rx_timeout, "RX idle timeout in character times (0 = off)");
+
+// Hybrid RX mode: the hard IRQ masks the RX interrupt and a thread polls the
+// FIFO every poll_us until it has been empty for poll_idle polls in a row
+static bool rx_poll = false;
+module_param(rx_poll, bool, 0444);
+MODULE_PARM_DESC(rx_poll, "Use a threaded IRQ that polls the RX FIFO under load");
+
+static unsigned int poll_us = 100;
+module_param(poll_us, uint, 0644);
+MODULE_PARM_DESC(poll_us, "RX poll interval in microseconds (rx_poll mode)");
+
+static unsigned int poll_idle = 4;
+module_param(poll_idle, uint, 0644);
+MODULE_PARM_DESC(poll_idle, "Empty polls before the RX interrupt is re-enabled (rx_poll mode)");
+
+// TX refill interrupt: raised while the hardware FIFO is at or below tx_low
+// entries, so the ring refills it while the line is still busy
+static unsigned int tx_low = 0;
+module_param(tx_low, uint, 0644);
+MODULE_PARM_DESC(tx_low, "TX FIFO low watermark in bytes (0 = a quarter of the FIFO)");
+
+// Interrupt moderation in the IP: caps the interrupt rate for both
+// directions by holding off a new interrupt for irq_spacing_us
+static unsigned int irq_spacing_us = 0;
+module_param(irq_spacing_us, uint, 0644);
+MODULE_PARM_DESC(irq_spacing_us, "Minimum spacing between interrupts in microseconds (0 = off)");
+
+// RTS/CTS flow control (CRTSCTS): the IP drops RTS once the RX FIFO holds
+// rts_level entries, before it can overflow, and holds TX while CTS is off
+static unsigned int rts_level = 0;
+module_param(rts_level, uint, 0644);
+MODULE_PARM_DESC(rts_level, "RX FIFO entries at which RTS drops with CRTSCTS (0 = 3/4 of the FIFO)");
+
+// IRQ placement: with irq_spread each IP's IRQ is pinned to CPU
+// (first line % online CPUs) at probe; irq_cpu in the IP's sysfs directory
+// moves it afterwards
+static bool irq_spread = true;
+module_param(irq_spread, bool, 0444);
+MODULE_PARM_DESC(irq_spread, "Spread port IRQs across the online CPUs by line number");
+
+
+static struct serialip_port *to_serialip_port(struct tty_port *port) {
+    return container_of(port, struct serialip_port, port);
+}
+
+// Set or clear bits in the control register
+static void serial_control_update(struct serialip_port *sp, uint32_t mask, bool set) {
+    uint32_t control = ioread32(sp->base + CONTROL_REG_OFFSET);
+
+    if (set)
+        control |= mask;
+    else
+        control &= ~mask;
+    iowrite32(control, sp->base + CONTROL_REG_OFFSET);
+}
+
+// FIFO fill levels; the status watermark fields saturate at 31 entries,
+// so deeper FIFOs read the exact counts from the level register
+static unsigned int serial_rx_level(struct serialip_port *sp, uint32_t status) {
+    if (sp->rx_fifo_depth > WATERMARK_MASK)
+        return LEVEL_RX(ioread32(sp->base + LEVEL_REG_OFFSET));
+    return RX_WATERMARK(status);
+}
+
+static unsigned int serial_tx_level(struct serialip_port *sp) {
+    if (sp->tx_fifo_depth > WATERMARK_MASK)
+        return LEVEL_TX(ioread32(sp->base + LEVEL_REG_OFFSET));
+    return TX_WATERMARK(ioread32(sp->base + STATUS_REG_OFFSET));
+}
+
+// FIFO data transfers: four bytes per bus access through the packed data
+// register, with the remainder going through the single-byte data register
+static void serial_fifo_write(struct serialip_port *sp, const unsigned char *buf, unsigned int count) {
+    unsigned int i;
+
+    for (i = 0; i + 4 <= count; i += 4)
+        iowrite32(get_unaligned_le32(buf + i), sp->base + PACKED_REG_OFFSET);
+    for (; i < count; i++)
+        iowrite32(buf[i], sp->base + DATA_REG_OFFSET);
+}
+
+static void serial_fifo_read(struct serialip_port *sp, unsigned char *buf, unsigned int count) {
+    unsigned int i;
 
-// Interrupt handler
+    for (i = 0; i + 4 <= count; i += 4)
+        put_unaligned_le32(ioread32(sp->base + PACKED_REG_OFFSET), buf + i);
+    for (; i < count; i++)
+        buf[i] = ioread32(sp->base + DATA_REG_OFFSET);
+}
+
+static void serial_dma_tx_callback(void *param);
+
+// Hand the next block of the TX ring to the DMA engine, which streams it into
+// the TX FIFO; the completion callback queues the block after it
+// Caller holds tx_lock
+static void serial_dma_tx_start(struct serialip_port *sp) {
+    struct dma_async_tx_descriptor *desc;
+    unsigned int count;
+
+    if (sp->tx_dma_busy || sp->tx_stopped || kfifo_is_empty(&sp->tx_ring))
+        return;
+
+    count = kfifo_out_peek(&sp->tx_ring, sp->tx_dma_buf, TX_DMA_BUF_SIZE);
+    desc = dmaengine_prep_slave_single(sp->dma_tx, sp->tx_dma_addr, count, DMA_MEM_TO_DEV,
+                                       DMA_PREP_INTERRUPT);
+    if (!desc)
+        return;
+    desc->callback = serial_dma_tx_callback;
+    desc->callback_param = sp;
+
+    // Consume what was just peeked now that the transfer is committed
+    kfifo_out(&sp->tx_ring, sp->tx_dma_buf, count);
+    sp->tx_dma_len = count;
+    sp->stats.tx_bytes += count;
+    trace_tx_enqueue(count, TX_DMA_BUF_SIZE);
+    sp->tx_dma_busy = true;
+    dmaengine_submit(desc);
+    dma_async_issue_pending(sp->dma_tx);
+}
+
+static void serial_dma_tx_callback(void *param) {
+    struct serialip_port *sp = param;
+    unsigned long flags;
+    unsigned int queued;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    sp->tx_dma_busy = false;
+    sp->tx_dma_len = 0;
+    serial_dma_tx_start(sp);
+    queued = kfifo_len(&sp->tx_ring);
+    if (queued < TX_WAKEUP_CHARS)
+        serial_stats_tx_stall_end(&sp->stats);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+
+    if (queued < TX_WAKEUP_CHARS)
+        tty_port_tty_wakeup(&sp->port);
+}
+
+// Push whatever the cyclic RX transfer has written since the last call
+// Called from the period callback and from the RX timeout interrupt
+static void serial_dma_rx_push(struct serialip_port *sp) {
+    struct dma_tx_state state;
+    unsigned long flags;
+    unsigned int head, count = 0, queued = 0;
+
+    spin_lock_irqsave(&sp->rx_dma_lock, flags);
+    dmaengine_tx_status(sp->dma_rx, sp->rx_dma_cookie, &state);
+    head = (RX_DMA_BUF_SIZE - state.residue) % RX_DMA_BUF_SIZE;
+    if (head < sp->rx_dma_tail) {
+        queued += RX_DMA_BUF_SIZE - sp->rx_dma_tail;
+        count += tty_insert_flip_string(&sp->port, sp->rx_dma_buf + sp->rx_dma_tail,
+                                        RX_DMA_BUF_SIZE - sp->rx_dma_tail);
+        sp->rx_dma_tail = 0;
+    }
+    if (head > sp->rx_dma_tail) {
+        queued += head - sp->rx_dma_tail;
+        count += tty_insert_flip_string(&sp->port, sp->rx_dma_buf + sp->rx_dma_tail,
+                                        head - sp->rx_dma_tail);
+    }
+    sp->rx_dma_tail = head;
+    sp->stats.rx_bytes += count;
+    sp->stats.ring_drops += queued - count;
+    spin_unlock_irqrestore(&sp->rx_dma_lock, flags);
+
+    trace_rx_drain(queued);
+    if (count) {
+        trace_rx_push(count);
+        tty_flip_buffer_push(&sp->port);
+    }
+}
+
+static void serial_dma_rx_callback(void *param) {
+    serial_dma_rx_push(param);
+}
+
+static int serial_dma_rx_start(struct serialip_port *sp) {
+    struct dma_async_tx_descriptor *desc;
+
+    desc = dmaengine_prep_dma_cyclic(sp->dma_rx, sp->rx_dma_addr, RX_DMA_BUF_SIZE,
+                                     RX_DMA_PERIOD_LEN, DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+    if (!desc)
+        return -EBUSY;
+    desc->callback = serial_dma_rx_callback;
+    desc->callback_param = sp;
+
+    sp->rx_dma_tail = 0;
+    sp->rx_dma_cookie = dmaengine_submit(desc);
+    dma_async_issue_pending(sp->dma_rx);
+    return 0;
+}
+
+// In RX DMA mode the hardware raises the RX timeout once the line goes idle
+// after data, which flushes a partial period to the tty
+static bool serial_dma_rx_service(struct serialip_port *sp, uint32_t status) {
+    if (!(status & RXTO))
+        return false;
+
+    iowrite32(RXTO, sp->base + STATUS_REG_OFFSET);
+    serial_dma_rx_push(sp);
+    return true;
+}
+
+// Move bytes from the TX ring into the free slots of the hardware FIFO
+// The TX low watermark interrupt stays enabled while the ring still has data
+// Caller holds tx_lock
+static void serial_tx_fill(struct serialip_port *sp) {
+    unsigned int room, count;
+    bool pending;
+
+    if (sp->tx_dma_active) {
+        serial_dma_tx_start(sp);
+        return;
+    }
+
+    if (!sp->tx_stopped && !kfifo_is_empty(&sp->tx_ring)) {
+        room = sp->tx_fifo_depth - serial_tx_level(sp);
+        count = kfifo_out(&sp->tx_ring, sp->tx_buf, room);
+        serial_fifo_write(sp, sp->tx_buf, count);
+        sp->stats.tx_bytes += count;
+        trace_tx_enqueue(count, room);
+    }
+
+    pending = !sp->tx_stopped && !kfifo_is_empty(&sp->tx_ring);
+    if (pending != sp->tx_int_enabled) {
+        serial_control_update(sp, INT_ON_TX_LOW_MASK, pending);
+        sp->tx_int_enabled = pending;
+    }
+}
+
+// Read count entries through the RXD register, which returns each byte
+// with its own break/parity/framing flags in a single access
+static void serial_rx_read_flagged(struct serialip_port *sp, unsigned int count) {
+    uint32_t rxd;
+    char flag;
+
+    while (count--) {
+        rxd = ioread32(sp->base + RXD_REG_OFFSET);
+        if (!(rxd & RXD_VALID))
+            break;
+        if (rxd & RXD_BRK)
+            flag = TTY_BREAK;
+        else if (rxd & RXD_PE)
+            flag = TTY_PARITY;
+        else if (rxd & RXD_FE)
+            flag = TTY_FRAME;
+        else
+            flag = TTY_NORMAL;
+        if (!tty_insert_flip_char(&sp->port, rxd & RXD_DATA_MASK, flag))
+            sp->stats.ring_drops++;
+    }
+}
+
+// Drain the RX FIFO in bursts: the watermark from one status read says how
+// many back-to-back data reads are safe, and the status is only re-read to
+// pick up bytes that arrived during the burst
+// Clean bursts use the packed register; while a flagged entry is queued
+// (RXERR) the burst goes through RXD so the error lands on the right byte
+// Returns the number of bytes received and leaves the last status in *status
+static unsigned int serial_rx_drain(struct serialip_port *sp, uint32_t *status) {
+    unsigned int count, total = 0;
+
+    count = serial_rx_level(sp, *status);
+    while (count) {
+        count = min(count, sp->rx_fifo_depth);
+        if (*status & RXERR) {
+            serial_rx_read_flagged(sp, count);
+        } else {
+            serial_fifo_read(sp, sp->rx_buf, count);
+            sp->stats.ring_drops += count - tty_insert_flip_string(&sp->port, sp->rx_buf, count);
+        }
+        total += count;
+        *status = ioread32(sp->base + STATUS_REG_OFFSET);
+        count = serial_rx_level(sp, *status);
+    }
+
+    trace_rx_drain(total);
+    return total;
+}
+
+// Refill TX FIFO from the ring once the hardware FIFO drains to the low
+// watermark
+// Also called from the rx_poll thread, where the DMA TX callback can run on
+// the same CPU, so the lock is taken irqsave like everywhere else
+static bool serial_tx_service(struct serialip_port *sp, uint32_t status) {
+    unsigned long flags;
+    unsigned int queued;
+
+    if (!((status & TXLOW) && sp->tx_int_enabled))
+        return false;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    serial_tx_fill(sp);
+    queued = kfifo_len(&sp->tx_ring);
+    if (queued < TX_WAKEUP_CHARS)
+        serial_stats_tx_stall_end(&sp->stats);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+
+    if (queued < TX_WAKEUP_CHARS)
+        tty_port_tty_wakeup(&sp->port);
+    return true;
+}
+
+// Count and clear the sticky overflow and line error flags
+static bool serial_error_service(struct serialip_port *sp, uint32_t status) {
+    uint32_t sticky = serial_stats_status(&sp->stats, status);
+
+    if (sticky)
+        iowrite32(sticky, sp->base + STATUS_REG_OFFSET);
+    return sticky != 0;
+}
+
+// Interrupt handler for one channel
 static irqreturn_t serial_irq_handler(int irq, void *dev_id) {
-    struct tty_struct *tty = tty_port_tty_get(&serial_tty_port);
-    if (!tty)
+    struct serialip_port *sp = dev_id;
+    irqreturn_t ret = IRQ_NONE;
+    uint32_t status = ioread32(sp->base + STATUS_REG_OFFSET);
+    unsigned int count;
+
+    trace_irq_entry(status);
+    if (serial_error_service(sp, status))
+        ret = IRQ_HANDLED;
+
+    if (sp->rx_dma_active) {
+        serial_stats_irq(&sp->stats, 0);
+        if (serial_dma_rx_service(sp, status))
+            ret = IRQ_HANDLED;
+        if (serial_tx_service(sp, status))
+            ret = IRQ_HANDLED;
+        return ret;
+    }
+
+    // Handle RX data; a closed port has its RX interrupts masked, so on the
+    // shared line its FIFO is left alone rather than pushed to an unused buffer
+    if (sp->rx_active) {
+        count = serial_rx_drain(sp, &status);
+        serial_stats_irq(&sp->stats, count);
+        if (count) {
+            trace_rx_push(count);
+            tty_flip_buffer_push(&sp->port);
+            ret = IRQ_HANDLED;
+        }
+    }
+
+    if (serial_tx_service(sp, status))
+        ret = IRQ_HANDLED;
+
+    return ret;
+}
+
+// Hard IRQ for rx_poll mode: TX is refilled here, RX is masked and left to the thread
+static irqreturn_t serial_irq_hardirq(int irq, void *dev_id) {
+    struct serialip_port *sp = dev_id;
+    unsigned long flags;
+    uint32_t status = ioread32(sp->base + STATUS_REG_OFFSET);
+
+    trace_irq_entry(status);
+    serial_error_service(sp, status);
+
+    if (sp->rx_dma_active) {
+        serial_stats_irq(&sp->stats, 0);
+        if (serial_dma_rx_service(sp, status) | serial_tx_service(sp, status))
+            return IRQ_HANDLED;
         return IRQ_NONE;
+    }
+
+    if (sp->rx_active && !(status & RXFE)) {
+        spin_lock_irqsave(&sp->tx_lock, flags);
+        serial_control_update(sp, RX_INT_MASKS, false);
+        spin_unlock_irqrestore(&sp->tx_lock, flags);
+        // Counted in the histogram once the thread is done with it
+        sp->rx_polling = true;
+        sp->rx_idle = 0;
+        sp->rx_poll_bytes = 0;
+        return IRQ_WAKE_THREAD;
+    }
 
-    uint32_t status = ioread32(base + STATUS_REG_OFFSET);
+    serial_stats_irq(&sp->stats, 0);
+    return serial_tx_service(sp, status) ? IRQ_HANDLED : IRQ_NONE;
+}
 
-    // Handle RX data
-    while (!(status & STATUS_RX_EMPTY_MASK)) {
-        char ch = (char)ioread32(base + (DATA_REG_OFFSET));
-        tty_insert_flip_char(&serial_tty_port, ch, TTY_NORMAL);
-        status = ioread32(base + (STATUS_REG_OFFSET));
+// One RX poll pass: drain the FIFO and refill TX; once the FIFO has been
+// empty for poll_idle passes the RX interrupt is re-enabled and the port
+// leaves poll mode (returns false)
+// rx_bytes grows with every pass; the interrupt that started polling goes
+// into the bytes-per-interrupt histogram with everything drained for it
+static bool serial_rx_poll(struct serialip_port *sp) {
+    uint32_t status = ioread32(sp->base + STATUS_REG_OFFSET);
+    unsigned int count = serial_rx_drain(sp, &status);
+    unsigned long flags;
+
+    if (count) {
+        trace_rx_push(count);
+        tty_flip_buffer_push(&sp->port);
+        sp->stats.rx_bytes += count;
+        sp->rx_poll_bytes += count;
+        sp->rx_idle = 0;
+    } else {
+        sp->rx_idle++;
     }
+    serial_tx_service(sp, status);
+    if (sp->rx_idle < poll_idle)
+        return true;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    if (sp->rx_active)
+        serial_control_update(sp, RX_INT_MASKS, true);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+    serial_stats_irq_done(&sp->stats, sp->rx_poll_bytes);
+    sp->rx_polling = false;
+    return false;
+}
+
+// Channels with an interrupt pending: one IPEND read on a multi-channel IP
+// (single-channel IPs predate the register)
+static unsigned long serial_block_pending(struct serialip_block *blk) {
+    if (blk->nports == 1)
+        return 1;
+    return ioread32(blk->base + IPEND_REG_OFFSET);
+}
 
-    tty_flip_buffer_push(&serial_tty_port);
-    tty_kref_put(tty);
+// Interrupt handler for the IP: services only the channels whose IPEND bit is set
+static irqreturn_t serial_block_irq(int irq, void *dev_id) {
+    struct serialip_block *blk = dev_id;
+    unsigned long pending = serial_block_pending(blk);
+    irqreturn_t ret = IRQ_NONE;
+    unsigned int k;
+
+    blk->irqs++;
+    for_each_set_bit(k, &pending, blk->nports)
+        if (serial_irq_handler(irq, blk->ports[k]) == IRQ_HANDLED)
+            ret = IRQ_HANDLED;
+    return ret;
+}
+
+// Hard IRQ for rx_poll mode: wakes the thread if any channel went to polling
+static irqreturn_t serial_block_hardirq(int irq, void *dev_id) {
+    struct serialip_block *blk = dev_id;
+    unsigned long pending = serial_block_pending(blk);
+    irqreturn_t ret = IRQ_NONE;
+    bool wake = false;
+    unsigned int k;
+
+    blk->irqs++;
+    for_each_set_bit(k, &pending, blk->nports) {
+        switch (serial_irq_hardirq(irq, blk->ports[k])) {
+        case IRQ_WAKE_THREAD:
+            wake = true;
+            break;
+        case IRQ_HANDLED:
+            ret = IRQ_HANDLED;
+            break;
+        default:
+            break;
+        }
+    }
+    return wake ? IRQ_WAKE_THREAD : ret;
+}
+
+// Threaded RX poller: keeps draining the polling channels while traffic is
+// heavy (the line is masked while this runs, so the other channels' pending
+// interrupts are serviced here as well, and may join the polling set)
+static irqreturn_t serial_block_thread(int irq, void *dev_id) {
+    struct serialip_block *blk = dev_id;
+    struct serialip_port *sp;
+    unsigned long pending;
+    bool polling;
+    unsigned int k;
+
+    do {
+        polling = false;
+        pending = serial_block_pending(blk);
+        for (k = 0; k < blk->nports; k++) {
+            sp = blk->ports[k];
+            if (!sp->rx_polling && test_bit(k, &pending))
+                serial_irq_hardirq(irq, sp);
+            if (sp->rx_polling && serial_rx_poll(sp))
+                polling = true;
+        }
+        if (polling)
+            usleep_range(poll_us, poll_us + poll_us / 2);
+    } while (polling);
 
     return IRQ_HANDLED;
 }
 
+// Program the line from termios: the closest rate the divisor can reach
+// (written back so tcgetattr reports it), word size, parity, stop bits and
+// CRTSCTS hardware flow control
+// An unreachable rate keeps the current one; mark/space parity is not
+// supported
+static void serial_apply_termios(struct serialip_port *sp, struct ktermios *termios,
+                                 const struct ktermios *old) {
+    unsigned long flags;
+    uint32_t baud = tty_termios_baud_rate(termios);
+    uint32_t brd, osr, control, actual = 0;
+    tcflag_t cflag = termios->c_cflag;
+
+    if (baud)
+        actual = serial_baud_divisor(CLK_FREQ, baud, &brd, &osr);
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    control = ioread32(sp->base + CONTROL_REG_OFFSET);
+    control &= ~(DATA_LENGTH_MASK | PARITY_MODE_MASK | STOP_BITS_MASK | AUTO_FLOW_MASK);
+    switch (cflag & CSIZE) {
+    case CS5: control |= 0; break;
+    case CS6: control |= 1; break;
+    case CS7: control |= 2; break;
+    default:  control |= 3; break;
+    }
+    if (cflag & PARENB)
+        control |= ((cflag & PARODD) ? 2 : 1) << 2;
+    if (cflag & CSTOPB)
+        control |= STOP_BITS_MASK;
+    if (cflag & CRTSCTS)
+        control |= AUTO_FLOW_MASK;
+    if (actual) {
+        control = (control & ~OSR_MASK) | (osr << OSR_OFFSET);
+        iowrite32(brd, sp->base + BRD_REG_OFFSET);
+    }
+    iowrite32(control, sp->base + CONTROL_REG_OFFSET);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+
+    termios->c_cflag &= ~CMSPAR;
+    if (actual)
+        tty_termios_encode_baud_rate(termios, actual, actual);
+    else if (baud && old)
+        tty_termios_encode_baud_rate(termios, tty_termios_baud_rate(old),
+                                     tty_termios_baud_rate(old));
+}
+
+// TTY port operations
+// With DMA channels the FIFOs are fed over AXI4-stream; the RX trigger
+// interrupt is not used then, only the RX timeout to flush partial periods
+static int serial_activate(struct tty_port *port, struct tty_struct *tty) {
+    struct serialip_port *sp = to_serialip_port(port);
+    unsigned long flags;
+    unsigned int trigger = rx_trigger ? rx_trigger : sp->rx_fifo_depth / 2;
+    unsigned int low = tx_low ? tx_low : sp->tx_fifo_depth / 4;
+    unsigned int rts = rts_level ? rts_level : sp->rx_fifo_depth * 3 / 4;
+    bool rx_dma = sp->dma_rx && serial_dma_rx_start(sp) == 0;
+
+    trigger = clamp(trigger, 1u, sp->rx_fifo_depth);
+    low = min(low, sp->tx_fifo_depth - 1);
+    rts = clamp(rts, 1u, sp->rx_fifo_depth);
+    serial_apply_termios(sp, &tty->termios, NULL);
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    kfifo_reset(&sp->tx_ring);
+    sp->tx_stopped = false;
+    sp->rx_active = true;
+    sp->rx_dma_active = rx_dma;
+    sp->tx_dma_active = sp->dma_tx != NULL;
+    iowrite32(RXCFG(trigger, rx_timeout), sp->base + RXCFG_REG_OFFSET);
+    iowrite32(low & TX_LOW_MASK, sp->base + TXCFG_REG_OFFSET);
+    iowrite32(min(irq_spacing_us, (unsigned int)IMOD_US_MASK), sp->base + IMOD_REG_OFFSET);
+    iowrite32(rts & FLOW_RTS_MASK, sp->base + FLOW_REG_OFFSET);
+    serial_control_update(sp, RTS_MASK, true);
+    if (sp->tx_dma_active)
+        serial_control_update(sp, TX_DMA_MASK, true);
+    if (sp->rx_dma_active)
+        serial_control_update(sp, RX_DMA_MASK | INT_ON_RX_TIMEOUT_MASK, true);
+    else
+        serial_control_update(sp, RX_INT_MASKS, true);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+
+    return 0;
+}
+
+static void serial_shutdown(struct tty_port *port) {
+    struct serialip_port *sp = to_serialip_port(port);
+    unsigned long flags;
+    bool rx_dma, tx_dma;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    serial_control_update(sp, RX_INT_MASKS | INT_ON_TX_LOW_MASK | RX_DMA_MASK | TX_DMA_MASK |
+                          RTS_MASK | AUTO_FLOW_MASK, false);
+    sp->rx_active = false;
+    sp->tx_int_enabled = false;
+    rx_dma = sp->rx_dma_active;
+    tx_dma = sp->tx_dma_active;
+    sp->rx_dma_active = false;
+    sp->tx_dma_active = false;
+    kfifo_reset(&sp->tx_ring);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+
+    if (rx_dma)
+        dmaengine_terminate_sync(sp->dma_rx);
+    if (tx_dma) {
+        dmaengine_terminate_sync(sp->dma_tx);
+        spin_lock_irqsave(&sp->tx_lock, flags);
+        sp->tx_dma_busy = false;
+        sp->tx_dma_len = 0;
+        spin_unlock_irqrestore(&sp->tx_lock, flags);
+    }
+}
+
+// Last reference to the port gone (remove() and the last tty close)
+static void serial_port_destruct(struct tty_port *port) {
+    struct serialip_port *sp = to_serialip_port(port);
+
+    kfree(sp->rx_buf);
+    kfree(sp->tx_buf);
+    kfree(sp);
+}
+
+static const struct tty_port_operations serial_port_ops = {
+    .activate = serial_activate,
+    .shutdown = serial_shutdown,
+    .destruct = serial_port_destruct,
+};
+
 // TTY Operations
+// install binds the tty to its port and takes a port reference for the
+// lifetime of the tty
+static int serial_install(struct tty_driver *driver, struct tty_struct *tty) {
+    struct serialip_port *sp;
+    int ret = -ENODEV;
+
+    mutex_lock(&ports_lock);
+    sp = ports[tty->index];
+    if (sp) {
+        tty->driver_data = sp;
+        ret = tty_port_install(&sp->port, driver, tty);
+        if (ret == 0)
+            tty_port_get(&sp->port);
+    }
+    mutex_unlock(&ports_lock);
+
+    return ret;
+}
+
+static void serial_cleanup(struct tty_struct *tty) {
+    struct serialip_port *sp = tty->driver_data;
+
+    tty->driver_data = NULL;
+    tty_port_put(&sp->port);
+}
+
 static int serial_open(struct tty_struct *tty, struct file *file) {
-    tty->driver_data = &serial_tty_port;
-    return tty_port_open(&serial_tty_port, tty, file);
+    struct serialip_port *sp = tty->driver_data;
+
+    return tty_port_open(&sp->port, tty, file);
 }
 
 static void serial_close(struct tty_struct *tty, struct file *file) {
-    tty_port_close(&serial_tty_port, tty, file);
+    struct serialip_port *sp = tty->driver_data;
+
+    tty_port_close(&sp->port, tty, file);
 }
 
+// Queue data in the TX ring and start transmission; never waits for the line
+// When the ring is empty the hardware FIFO's free slots count as room too,
+// so the second pass picks up whatever serial_tx_fill() made space for
 static int serial_write(struct tty_struct *tty, const unsigned char *buffer, int count) {
-    int i;
-    uint32_t status;
+    struct serialip_port *sp = tty->driver_data;
+    unsigned long flags;
+    int copied;
 
-    for (i = 0; i < count; i++) {
-        do {
-            status = ioread32(base + (STATUS_REG_OFFSET));
-        } while (status & STATUS_TX_FULL_MASK); // Wait for space in TX FIFO
-
-        iowrite32(buffer[i], base + (DATA_REG_OFFSET));
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    trace_tx_write(count, kfifo_len(&sp->tx_ring));
+    copied = kfifo_in(&sp->tx_ring, buffer, count);
+    serial_tx_fill(sp);
+    if (copied < count) {
+        copied += kfifo_in(&sp->tx_ring, buffer + copied, count - copied);
+        serial_tx_fill(sp);
     }
+    if (copied < count)
+        serial_stats_tx_stall_begin(&sp->stats);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
 
-    return count;
+    return copied;
 }
 
 static unsigned int serial_write_room(struct tty_struct *tty) {
-    uint32_t status = ioread32(base + (STATUS_REG_OFFSET));
-    return (status & STATUS_TX_FULL_MASK) ? 0 : TTY_BUFFER_SIZE;
+    struct serialip_port *sp = tty->driver_data;
+    unsigned long flags;
+    unsigned int room;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    room = kfifo_avail(&sp->tx_ring);
+    if (kfifo_is_empty(&sp->tx_ring) && !sp->tx_dma_active)
+        room += sp->tx_fifo_depth - serial_tx_level(sp);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+
+    return room;
+}
+
+// Bytes queued in the TX ring or an in-flight DMA block plus entries still
+// in the hardware FIFO
+static unsigned int serial_chars_in_buffer(struct tty_struct *tty) {
+    struct serialip_port *sp = tty->driver_data;
+    unsigned long flags;
+    unsigned int chars;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    chars = kfifo_len(&sp->tx_ring) + sp->tx_dma_len + serial_tx_level(sp);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+
+    return chars;
+}
+
+// Discard data not yet handed to the hardware FIFO
+static void serial_flush_buffer(struct tty_struct *tty) {
+    struct serialip_port *sp = tty->driver_data;
+    unsigned long flags;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    kfifo_reset(&sp->tx_ring);
+    serial_tx_fill(sp);
+    serial_stats_tx_stall_end(&sp->stats);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+
+    tty_wakeup(tty);
+}
+
+// Sleep one character time at a time until the ring and FIFO have drained,
+// then one more for the character in the transmitter shift register
+static void serial_wait_until_sent(struct tty_struct *tty, int timeout) {
+    unsigned long expire = jiffies + timeout;
+    unsigned int baud = tty_get_baud_rate(tty);
+    unsigned long char_time;
+
+    if (baud == 0)
+        baud = 9600;
+    char_time = max_t(unsigned long, 1, msecs_to_jiffies(12 * 1000 / baud));
+
+    while (serial_chars_in_buffer(tty)) {
+        if (schedule_timeout_interruptible(char_time))
+            return;
+        if (signal_pending(current))
+            return;
+        if (timeout && time_after(jiffies, expire))
+            return;
+    }
+    schedule_timeout_interruptible(char_time);
+}
+
+static void serial_set_termios(struct tty_struct *tty, const struct ktermios *old) {
+    serial_apply_termios(tty->driver_data, &tty->termios, old);
+}
+
+// Flow control (XON/XOFF or tcflow) stops and restarts the TX ring
+static void serial_stop(struct tty_struct *tty) {
+    struct serialip_port *sp = tty->driver_data;
+    unsigned long flags;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    sp->tx_stopped = true;
+    serial_tx_fill(sp);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+}
+
+static void serial_start(struct tty_struct *tty) {
+    struct serialip_port *sp = tty->driver_data;
+    unsigned long flags;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    sp->tx_stopped = false;
+    serial_tx_fill(sp);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+}
+
+// With CRTSCTS a full line discipline drops RTS as well, so the far end
+// pauses instead of the RX FIFO filling behind the throttled tty
+static void serial_throttle(struct tty_struct *tty) {
+    struct serialip_port *sp = tty->driver_data;
+    unsigned long flags;
+
+    if (!C_CRTSCTS(tty))
+        return;
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    serial_control_update(sp, RTS_MASK, false);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+}
+
+static void serial_unthrottle(struct tty_struct *tty) {
+    struct serialip_port *sp = tty->driver_data;
+    unsigned long flags;
+
+    if (!C_CRTSCTS(tty))
+        return;
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    serial_control_update(sp, RTS_MASK, true);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+}
+
+// Modem lines: RTS and CTS are the IP's pins (RTS as driven, including an
+// automatic drop at the RTS level); there is no carrier or DSR, so those
+// read as asserted. TIOCM_LOOP maps to the internal loopback bit
+// (control[12])
+static int serial_tiocmget(struct tty_struct *tty) {
+    struct serialip_port *sp = tty->driver_data;
+    uint32_t status = ioread32(sp->base + STATUS_REG_OFFSET);
+    int result = TIOCM_CAR | TIOCM_DSR;
+
+    if (status & CTS)
+        result |= TIOCM_CTS;
+    if (status & RTS)
+        result |= TIOCM_RTS;
+    if (ioread32(sp->base + CONTROL_REG_OFFSET) & LOOPBACK_MASK)
+        result |= TIOCM_LOOP;
+    return result;
+}
+
+static int serial_tiocmset(struct tty_struct *tty, unsigned int set, unsigned int clear) {
+    struct serialip_port *sp = tty->driver_data;
+    unsigned long flags;
+
+    spin_lock_irqsave(&sp->tx_lock, flags);
+    if (set & TIOCM_LOOP)
+        serial_control_update(sp, LOOPBACK_MASK, true);
+    else if (clear & TIOCM_LOOP)
+        serial_control_update(sp, LOOPBACK_MASK, false);
+    if (set & TIOCM_RTS)
+        serial_control_update(sp, RTS_MASK, true);
+    else if (clear & TIOCM_RTS)
+        serial_control_update(sp, RTS_MASK, false);
+    spin_unlock_irqrestore(&sp->tx_lock, flags);
+
+    return 0;
+}
+
+// /proc/tty/driver/ttyserial
+static int serial_proc_show(struct seq_file *m, void *v) {
+    struct serialip_port *sp;
+    unsigned int line;
+
+    seq_puts(m, "serinfo:1.0 driver revision:\n");
+    mutex_lock(&ports_lock);
+    for (line = 0; line < SERIAL_MAX_PORTS; line++) {
+        sp = ports[line];
+        if (!sp)
+            continue;
+        seq_printf(m, "%u: uart:serialip mmio:0x%08llX irq:%u", line,
+                   (unsigned long long)sp->phys, sp->blk->irq);
+        serial_stats_proc_line(m, &sp->stats);
+        seq_putc(m, '\n');
+    }
+    mutex_unlock(&ports_lock);
+    return 0;
 }
 
 static const struct tty_operations serial_tty_ops = {
+    .install = serial_install,
+    .cleanup = serial_cleanup,
     .open = serial_open,
     .close = serial_close,
     .write = serial_write,
     .write_room = serial_write_room,
+    .chars_in_buffer = serial_chars_in_buffer,
+    .flush_buffer = serial_flush_buffer,
+    .wait_until_sent = serial_wait_until_sent,
+    .stop = serial_stop,
+    .start = serial_start,
+    .throttle = serial_throttle,
+    .unthrottle = serial_unthrottle,
+    .set_termios = serial_set_termios,
+    .tiocmget = serial_tiocmget,
+    .tiocmset = serial_tiocmset,
+    .proc_show = serial_proc_show,
+};
+// Interrupt statistics and IRQ placement in /sys/bus/platform/devices/<dev>/
+// These are per IP: the channels of a multi-channel IP share one interrupt
+static u64 serial_block_rx_bytes(struct serialip_block *blk) {
+    u64 rx = 0;
+    unsigned int k;
+
+    for (k = 0; k < blk->nports; k++)
+        rx += blk->ports[k]->stats.rx_bytes;
+    return rx;
+}
+
+static ssize_t irq_count_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    struct serialip_block *blk = dev_get_drvdata(dev);
+
+    return sprintf(buffer, "%llu\n", blk->irqs);
+}
+
+static ssize_t rx_bytes_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    struct serialip_block *blk = dev_get_drvdata(dev);
+
+    return sprintf(buffer, "%llu\n", serial_block_rx_bytes(blk));
+}
+
+static ssize_t bytes_per_irq_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    struct serialip_block *blk = dev_get_drvdata(dev);
+    u64 irqs = blk->irqs ? blk->irqs : 1;
+    unsigned long centi = div64_u64(serial_block_rx_bytes(blk) * 100, irqs);
+
+    return sprintf(buffer, "%lu.%02lu\n", centi / 100, centi % 100);
+}
+
+// tty lines of the IP's channels, channel 0 first
+static ssize_t lines_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    struct serialip_block *blk = dev_get_drvdata(dev);
+    unsigned int k;
+    int len = 0;
+
+    for (k = 0; k < blk->nports; k++)
+        len += sprintf(buffer + len, "%s%u", k ? " " : "", blk->ports[k]->line);
+    len += sprintf(buffer + len, "\n");
+    return len;
+}
+
+// Pin the IP's IRQ to one CPU; -1 releases it to any online CPU
+static int serial_irq_pin(struct serialip_block *blk, int cpu) {
+    int ret;
+
+    if (cpu < 0)
+        ret = irq_set_affinity_and_hint(blk->irq, NULL);
+    else
+        ret = irq_set_affinity_and_hint(blk->irq, cpumask_of(cpu));
+    if (ret == 0)
+        blk->irq_cpu = cpu;
+    return ret;
+}
+
+static ssize_t irq_cpu_show(struct device *dev, struct device_attribute *attr, char *buffer) {
+    struct serialip_block *blk = dev_get_drvdata(dev);
+
+    return sprintf(buffer, "%d\n", blk->irq_cpu);
+}
+
+static ssize_t irq_cpu_store(struct device *dev, struct device_attribute *attr,
+                             const char *buffer, size_t count) {
+    struct serialip_block *blk = dev_get_drvdata(dev);
+    int cpu, ret;
+
+    ret = kstrtoint(buffer, 0, &cpu);
+    if (ret)
+        return ret;
+    if (cpu >= 0 && (cpu >= nr_cpu_ids || !cpu_online(cpu)))
+        return -EINVAL;
+    ret = serial_irq_pin(blk, cpu < 0 ? -1 : cpu);
+    return ret ? ret : count;
+}
+
+static DEVICE_ATTR_RO(irq_count);
+static DEVICE_ATTR_RO(rx_bytes);
+static DEVICE_ATTR_RO(bytes_per_irq);
+static DEVICE_ATTR_RO(lines);
+static DEVICE_ATTR_RW(irq_cpu);
+
+static struct attribute *serial_attrs[] = {
+    &dev_attr_irq_count.attr,
+    &dev_attr_rx_bytes.attr,
+    &dev_attr_bytes_per_irq.attr,
+    &dev_attr_lines.attr,
+    &dev_attr_irq_cpu.attr,
+    NULL
 };
-static int probe(struct platform_device* dev) {
-	int result = 0;
-	unsigned int irq;
-	printk(KERN_INFO "serial isr: probe \n");
-	
-	irq = irq_of_parse_and_map(dev->dev.of_node, 0);
-	printk(KERN_INFO "serial isr: found irq = %d in device tree\n", irq);
-	
-	result = request_irq(irq, ir, IRQF_SHARED, "serial ip", &dev->dev);
-	if(result != 0)
-		printk(KERN_INFO "serial iser: request_irq returned %d\n", result);
-	else 
-		printk(KERN_INFO "serial iser: request_irq was successful");
-	
+ATTRIBUTE_GROUPS(serial);
+
+// Optional DMA channels, named in the device tree node as
+//   dmas = <&axi_dma_0 0 &axi_dma_0 1>;
+//   dma-names = "tx", "rx";
+// A missing channel leaves that direction on PIO
+static struct dma_chan *serial_dma_request(struct device *dev, const char *name,
+					   unsigned char **buf, dma_addr_t *addr, size_t size) {
+	struct dma_chan *chan = dma_request_chan(dev, name);
+
+	if (IS_ERR(chan))
+		return chan;
+
+	*buf = dma_alloc_coherent(chan->device->dev, size, addr, GFP_KERNEL);
+	if (!*buf) {
+		dma_release_channel(chan);
+		return ERR_PTR(-ENOMEM);
+	}
+	return chan;
+}
+
+static void serial_dma_release(struct dma_chan *chan, unsigned char *buf,
+			       dma_addr_t addr, size_t size) {
+	if (!chan)
+		return;
+	dmaengine_terminate_sync(chan);
+	dma_free_coherent(chan->device->dev, size, buf, addr);
+	dma_release_channel(chan);
+}
+
+static void serial_dma_exit(struct serialip_port *sp) {
+	serial_dma_release(sp->dma_tx, sp->tx_dma_buf, sp->tx_dma_addr, TX_DMA_BUF_SIZE);
+	serial_dma_release(sp->dma_rx, sp->rx_dma_buf, sp->rx_dma_addr, RX_DMA_BUF_SIZE);
+	sp->dma_tx = NULL;
+	sp->dma_rx = NULL;
+}
+
+static int serial_dma_init(struct serialip_port *sp) {
+	struct dma_chan *chan;
+
+	chan = serial_dma_request(sp->dev, "rx", &sp->rx_dma_buf, &sp->rx_dma_addr, RX_DMA_BUF_SIZE);
+	if (PTR_ERR_OR_ZERO(chan) == -EPROBE_DEFER)
+		return -EPROBE_DEFER;
+	sp->dma_rx = IS_ERR(chan) ? NULL : chan;
+
+	chan = serial_dma_request(sp->dev, "tx", &sp->tx_dma_buf, &sp->tx_dma_addr, TX_DMA_BUF_SIZE);
+	if (PTR_ERR_OR_ZERO(chan) == -EPROBE_DEFER) {
+		serial_dma_exit(sp);
+		return -EPROBE_DEFER;
+	}
+	sp->dma_tx = IS_ERR(chan) ? NULL : chan;
+
+	dev_info(sp->dev, "rx %s, tx %s\n", sp->dma_rx ? "dma" : "pio", sp->dma_tx ? "dma" : "pio");
+	return 0;
+}
+
+// Line number: the "ttyserial" alias plus the channel index when the device
+// tree has one (aliases { ttyserial4 = &serial_1; } puts a 4-channel IP on
+// lines 4-7), otherwise the lowest free line
+static int serial_line_alloc(struct device *dev, unsigned int channel) {
+	int id = of_alias_get_id(dev->of_node, DEVICE_NAME);
+
+	if (id >= 0 && id + channel < SERIAL_MAX_PORTS)
+		return ida_alloc_range(&port_ida, id + channel, id + channel, GFP_KERNEL);
+	return ida_alloc_max(&port_ida, SERIAL_MAX_PORTS - 1, GFP_KERNEL);
+}
+
+// Port state for one channel, with its RX/TX burst buffers sized to the
+// channel's FIFOs; the port reference owns it, tty_port_put() frees it
+static struct serialip_port *serial_port_create(struct serialip_block *blk, unsigned int channel) {
+	struct serialip_port *sp;
+	uint32_t cap;
+
+	sp = kzalloc(sizeof(*sp), GFP_KERNEL);
+	if (!sp)
+		return ERR_PTR(-ENOMEM);
+	tty_port_init(&sp->port);
+	sp->port.ops = &serial_port_ops;
+	sp->dev = blk->dev;
+	sp->blk = blk;
+	sp->channel = channel;
+	sp->base = blk->base + channel * CHANNEL_SPAN_WORDS;
+	sp->phys = blk->phys + channel * SPAN_IN_BYTES;
+	spin_lock_init(&sp->tx_lock);
+	spin_lock_init(&sp->rx_dma_lock);
+	INIT_KFIFO(sp->tx_ring);
+
+	cap = ioread32(sp->base + CAP_REG_OFFSET);
+	sp->rx_fifo_depth = CAP_RX_DEPTH(cap);
+	sp->tx_fifo_depth = CAP_TX_DEPTH(cap);
+	sp->rx_buf = kmalloc(sp->rx_fifo_depth, GFP_KERNEL);
+	sp->tx_buf = kmalloc(sp->tx_fifo_depth, GFP_KERNEL);
+	if (!sp->rx_buf || !sp->tx_buf) {
+		tty_port_put(&sp->port);
+		return ERR_PTR(-ENOMEM);
+	}
+	return sp;
+}
+
+// Publish the port: statistics, the line table and /dev/ttyserialN
+static int serial_port_register(struct serialip_port *sp) {
+	struct device *tty_dev;
+	char name[16];
+
+	snprintf(name, sizeof(name), DEVICE_NAME "%u", sp->line);
+	sp->stats_dir = serial_stats_debugfs(name, stats_root, &sp->stats);
+
+	mutex_lock(&ports_lock);
+	ports[sp->line] = sp;
+	mutex_unlock(&ports_lock);
+
+	tty_dev = tty_port_register_device(&sp->port, serial_tty_driver, sp->line, sp->dev);
+	if (IS_ERR(tty_dev)) {
+		mutex_lock(&ports_lock);
+		ports[sp->line] = NULL;
+		mutex_unlock(&ports_lock);
+		debugfs_remove_recursive(sp->stats_dir);
+		return PTR_ERR(tty_dev);
+	}
+
+	dev_info(sp->dev, "%s channel %u at 0x%08llx irq %u (%s), RX FIFO %u, TX FIFO %u\n",
+		 name, sp->channel, (unsigned long long)sp->phys, sp->blk->irq,
+		 rx_poll ? "threaded rx poll" : "interrupt", sp->rx_fifo_depth, sp->tx_fifo_depth);
+	return 0;
+}
+
+// No new opens; hang up any open tty and wait for it, so nothing touches
+// the registers once the devm mapping is released
+static void serial_port_unregister(struct serialip_port *sp) {
+	mutex_lock(&ports_lock);
+	ports[sp->line] = NULL;
+	mutex_unlock(&ports_lock);
+	tty_port_unregister_device(&sp->port, serial_tty_driver, sp->line);
+	tty_port_tty_vhangup(&sp->port);
+	debugfs_remove_recursive(sp->stats_dir);
+}
+
+// One IP per serial node: registers and interrupt come from the node's reg
+// and interrupts properties, and each channel the IP reports in CAP gets
+// its own port
+static int probe(struct platform_device* pdev) {
+	struct serialip_block *blk;
+	struct resource *res;
+	unsigned int k, nlines = 0, nreg = 0;
+	uint32_t cap;
+	int result;
+
+	blk = devm_kzalloc(&pdev->dev, sizeof(*blk), GFP_KERNEL);
+	if (!blk)
+		return -ENOMEM;
+	blk->dev = &pdev->dev;
+	blk->irq_cpu = -1;
+
+	blk->base = devm_platform_get_and_ioremap_resource(pdev, 0, &res);
+	if (IS_ERR(blk->base))
+		return PTR_ERR(blk->base);
+	blk->phys = res->start;
+
+	result = platform_get_irq(pdev, 0);
+	if (result < 0)
+		return result;
+	blk->irq = result;
+
+	cap = ioread32(blk->base + CAP_REG_OFFSET);
+	blk->nports = CAP_CHANNELS(cap);
+	if ((resource_size_t)blk->nports * SPAN_IN_BYTES > resource_size(res)) {
+		dev_err(&pdev->dev, "reg is too small for %u channels\n", blk->nports);
+		return -EINVAL;
+	}
+
+	for (k = 0; k < blk->nports; k++) {
+		blk->ports[k] = serial_port_create(blk, k);
+		if (IS_ERR(blk->ports[k])) {
+			result = PTR_ERR(blk->ports[k]);
+			blk->ports[k] = NULL;
+			goto fail_ports;
+		}
+	}
+
+	// The AXI stream ports serve channel 0 only
+	result = serial_dma_init(blk->ports[0]);
+	if (result)
+		goto fail_ports;
+
+	mutex_lock(&ports_lock);
+	for (; nlines < blk->nports; nlines++) {
+		result = serial_line_alloc(&pdev->dev, nlines);
+		if (result < 0)
+			break;
+		blk->ports[nlines]->line = result;
+	}
+	mutex_unlock(&ports_lock);
+	if (result < 0)
+		goto fail_lines;
+	platform_set_drvdata(pdev, blk);
+
+	if (rx_poll)
+		result = request_threaded_irq(blk->irq, serial_block_hardirq, serial_block_thread,
+					      IRQF_SHARED | IRQF_ONESHOT, dev_name(&pdev->dev), blk);
+	else
+		result = request_irq(blk->irq, serial_block_irq, IRQF_SHARED, dev_name(&pdev->dev), blk);
+	if (result) {
+		dev_err(&pdev->dev, "request_irq returned %d\n", result);
+		goto fail_lines;
+	}
+	if (irq_spread)
+		serial_irq_pin(blk, cpumask_local_spread(blk->ports[0]->line, NUMA_NO_NODE));
+
+	for (; nreg < blk->nports; nreg++) {
+		result = serial_port_register(blk->ports[nreg]);
+		if (result)
+			goto fail_register;
+	}
+	return 0;
+
+fail_register:
+	while (nreg--)
+		serial_port_unregister(blk->ports[nreg]);
+	irq_set_affinity_and_hint(blk->irq, NULL);
+	free_irq(blk->irq, blk);
+fail_lines:
+	while (nlines--)
+		ida_free(&port_ida, blk->ports[nlines]->line);
+	serial_dma_exit(blk->ports[0]);
+fail_ports:
+	for (k = 0; k < blk->nports; k++)
+		if (blk->ports[k])
+			tty_port_put(&blk->ports[k]->port);
 	return result;
 }
 
-static int remove(struct platform_device* dev) 
+static int remove(struct platform_device* pdev)
 {
-	printk(KERN_INFO "serial isr: remove\n");
-	
-	free_irq(of_irq_get(dev->dev.of_node, 0), &dev->dev);
-	
+	struct serialip_block *blk = platform_get_drvdata(pdev);
+	struct serialip_port *sp;
+	unsigned int k;
+
+	for (k = 0; k < blk->nports; k++) {
+		sp = blk->ports[k];
+		serial_port_unregister(sp);
+		serial_control_update(sp, RX_INT_MASKS | INT_ON_TX_MASK | INT_ON_TX_LOW_MASK |
+				      RX_DMA_MASK | TX_DMA_MASK | RTS_MASK | AUTO_FLOW_MASK, false);
+	}
+	irq_set_affinity_and_hint(blk->irq, NULL);
+	free_irq(blk->irq, blk);
+	serial_dma_exit(blk->ports[0]);
+
+	for (k = 0; k < blk->nports; k++) {
+		ida_free(&port_ida, blk->ports[k]->line);
+		tty_port_put(&blk->ports[k]->port);
+	}
 	return 0;
 }
 
@@ -131,32 +1363,26 @@ static struct platform_driver driver = {
 	.probe = probe,
 	.remove = remove,
 	.driver = {
-		.name = "serial isr",
+		.name = "serial tty",
 		.owner = THIS_MODULE,
 		.of_match_table = driver_of_match,
+		.dev_groups = serial_groups,
 	},
 };
 // Initialization and Exit
+// The tty driver is registered first with room for SERIAL_MAX_PORTS lines;
+// each probed instance then registers its own ttyserialN
 static int __init serial_tty_init(void) {
     int ret;
 
-    // Map serial registers
-    base = (uint32_t*)ioremap(AXI4_LITE_BASE + SERIAL_BASE_OFFSET, SPAN_IN_BYTES);
-    if (!base) {
-        printk(KERN_ALERT "Failed to map serial registers\n");
-        return -ENOMEM;
-    }
-
     // Allocate TTY driver
-    serial_tty_driver = tty_alloc_driver(1, TTY_DRIVER_REAL_RAW | TTY_DRIVER_DYNAMIC_DEV);
-    if (!serial_tty_driver) {
-        iounmap(base);
-        return -ENOMEM;
-    }
+    serial_tty_driver = tty_alloc_driver(SERIAL_MAX_PORTS, TTY_DRIVER_REAL_RAW | TTY_DRIVER_DYNAMIC_DEV);
+    if (IS_ERR(serial_tty_driver))
+        return PTR_ERR(serial_tty_driver);
 
     serial_tty_driver->driver_name = DEVICE_NAME;
     serial_tty_driver->name = "ttyserial";
-    serial_tty_driver->major = TTY_MAJOR;
+    serial_tty_driver->major = 0;
     serial_tty_driver->minor_start = 0;
     serial_tty_driver->type = TTY_DRIVER_TYPE_SERIAL;
     serial_tty_driver->subtype = SERIAL_TYPE_NORMAL;
@@ -164,31 +1390,38 @@ static int __init serial_tty_init(void) {
     serial_tty_driver->init_termios.c_cflag = B9600 | CS8 | CREAD | HUPCL | CLOCAL;
     tty_set_operations(serial_tty_driver, &serial_tty_ops);
 
-    // Initialize TTY port
-    tty_port_init(&serial_tty_port);
-
     ret = tty_register_driver(serial_tty_driver);
     if (ret) {
         printk(KERN_ALERT "Failed to register TTY driver\n");
         tty_driver_kref_put(serial_tty_driver);
-        iounmap(base);
         return ret;
     }
-	
+
+    stats_root = debugfs_create_dir("serial_tty", NULL);
+
+    // Bind the serial IP instances
+    ret = platform_driver_register(&driver);
+    if (ret) {
+        printk(KERN_ALERT "Failed to register platform driver\n");
+        debugfs_remove_recursive(stats_root);
+        tty_unregister_driver(serial_tty_driver);
+        tty_driver_kref_put(serial_tty_driver);
+        return ret;
+    }
 
     printk(KERN_INFO "Serial TTY driver initialized\n");
     return 0;
 }
 
 static void __exit serial_tty_exit(void) {
+    platform_driver_unregister(&driver);
+    debugfs_remove_recursive(stats_root);
     tty_unregister_driver(serial_tty_driver);
-    tty_port_destroy(&serial_tty_port);
     tty_driver_kref_put(serial_tty_driver);
-    iounmap(base);
+    ida_destroy(&port_ida);
 
     printk(KERN_INFO "Serial TTY driver exited\n");
 }
 
 module_init(serial_tty_init);
 module_exit(serial_tty_exit);
-
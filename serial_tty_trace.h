@@ -0,0 +1,95 @@
+// Serial TTY Driver Tracepoints
+// Olajumoke Aboderin
+
+// Events in /sys/kernel/tracing/events/serial_tty/, for measuring the
+// IRQ to flip buffer push and write to FIFO enqueue latencies:
+//   irq_entry    status register at interrupt entry
+//   rx_drain     bytes read from the RX FIFO by one drain
+//   rx_push      bytes handed to the tty layer by tty_flip_buffer_push()
+//   tx_write     bytes offered to the tty write op and bytes already
+//                queued ahead of them in the TX ring
+//   tx_enqueue   bytes moved from the TX ring into the hardware FIFO (or a
+//                DMA block) and the room the FIFO had
+// Disabled tracepoints are a patched-out branch, so they cost nothing
+// until enabled; serial_trace_hist.py turns a capture into histograms
+//
+// The module build needs this directory on the include path:
+//   CFLAGS_serial_tty_driver.o := -I$(src)
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM serial_tty
+
+#if !defined(SERIAL_TTY_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define SERIAL_TTY_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(irq_entry,
+	TP_PROTO(u32 status),
+	TP_ARGS(status),
+	TP_STRUCT__entry(
+		__field(u32, status)
+	),
+	TP_fast_assign(
+		__entry->status = status;
+	),
+	TP_printk("status=0x%08x", __entry->status)
+);
+
+DECLARE_EVENT_CLASS(serial_tty_count,
+	TP_PROTO(unsigned int count),
+	TP_ARGS(count),
+	TP_STRUCT__entry(
+		__field(unsigned int, count)
+	),
+	TP_fast_assign(
+		__entry->count = count;
+	),
+	TP_printk("count=%u", __entry->count)
+);
+
+DEFINE_EVENT(serial_tty_count, rx_drain,
+	TP_PROTO(unsigned int count),
+	TP_ARGS(count)
+);
+
+DEFINE_EVENT(serial_tty_count, rx_push,
+	TP_PROTO(unsigned int count),
+	TP_ARGS(count)
+);
+
+TRACE_EVENT(tx_write,
+	TP_PROTO(unsigned int count, unsigned int queued),
+	TP_ARGS(count, queued),
+	TP_STRUCT__entry(
+		__field(unsigned int, count)
+		__field(unsigned int, queued)
+	),
+	TP_fast_assign(
+		__entry->count = count;
+		__entry->queued = queued;
+	),
+	TP_printk("count=%u queued=%u", __entry->count, __entry->queued)
+);
+
+TRACE_EVENT(tx_enqueue,
+	TP_PROTO(unsigned int count, unsigned int room),
+	TP_ARGS(count, room),
+	TP_STRUCT__entry(
+		__field(unsigned int, count)
+		__field(unsigned int, room)
+	),
+	TP_fast_assign(
+		__entry->count = count;
+		__entry->room = room;
+	),
+	TP_printk("count=%u room=%u", __entry->count, __entry->room)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE serial_tty_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,321 @@
+// Serial IP User-Space Library
+// Olajumoke Aboderin
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Xilinx XUP Blackboard
+
+// Hardware configuration:
+//
+// AXI4-Lite interface:
+//  Mapped to offset of 0x20000 (passed to serial_open by the caller)
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "serialip.h"
+#include "serial_baud.h"
+
+struct serial_dev {
+	volatile uint32_t *base;
+	void *map;                  // page-aligned mapping holding base
+	size_t map_len;
+	uint32_t rx_depth;
+	uint32_t tx_depth;
+	int uio_fd;                 // -1 for /dev/mem mappings
+};
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Wrap a mapping in a handle, with the registers offset bytes into it;
+// takes ownership of map and uio_fd
+static serial_dev_t *serial_attach(void *map, size_t map_len, size_t offset, int uio_fd)
+{
+	serial_dev_t *dev = calloc(1, sizeof(*dev));
+	uint32_t cap;
+
+	if (!dev) {
+		munmap(map, map_len);
+		if (uio_fd >= 0)
+			close(uio_fd);
+		return NULL;
+	}
+	dev->map = map;
+	dev->map_len = map_len;
+	dev->base = (volatile uint32_t *)((char *)map + offset);
+	dev->uio_fd = uio_fd;
+	cap = dev->base[CAP_REG_OFFSET];
+	dev->rx_depth = CAP_RX_DEPTH(cap);
+	dev->tx_depth = CAP_TX_DEPTH(cap);
+	return dev;
+}
+
+// mmap needs a page-aligned offset, and channel n of a multi-channel IP
+// sits at base + 64 * n, so map from the page holding phys_base
+serial_dev_t *serial_open(off_t phys_base)
+{
+	void *map;
+	off_t page = phys_base & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+	size_t offset = phys_base - page;
+	size_t len = offset + SPAN_IN_BYTES;
+	int file = open("/dev/mem", O_RDWR | O_SYNC);
+
+	if (file < 0)
+		return NULL;
+	map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, file, page);
+	close(file);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	return serial_attach(map, len, offset, -1);
+}
+
+// UIO map 0 is the register block; the descriptor stays open for interrupts
+serial_dev_t *serial_open_uio(const char *path)
+{
+	void *map;
+	int file = open(path, O_RDWR | O_CLOEXEC);
+
+	if (file < 0)
+		return NULL;
+	map = mmap(NULL, SPAN_IN_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (map == MAP_FAILED) {
+		int err = errno;
+		close(file);
+		errno = err;
+		return NULL;
+	}
+
+	return serial_attach(map, SPAN_IN_BYTES, 0, file);
+}
+
+void serial_close(serial_dev_t *dev)
+{
+	if (!dev)
+		return;
+	munmap(dev->map, dev->map_len);
+	if (dev->uio_fd >= 0)
+		close(dev->uio_fd);
+	free(dev);
+}
+
+uint32_t serial_read_reg(serial_dev_t *dev, unsigned int reg)
+{
+	return dev->base[reg];
+}
+
+void serial_write_reg(serial_dev_t *dev, unsigned int reg, uint32_t value)
+{
+	dev->base[reg] = value;
+}
+
+void serial_update_reg(serial_dev_t *dev, unsigned int reg, uint32_t mask, uint32_t value)
+{
+	dev->base[reg] = (dev->base[reg] & ~mask) | (value & mask);
+}
+
+uint32_t serial_status(serial_dev_t *dev)
+{
+	return dev->base[STATUS_REG_OFFSET];
+}
+
+// Status flags are write 1 to clear
+void serial_clear_status(serial_dev_t *dev, uint32_t mask)
+{
+	dev->base[STATUS_REG_OFFSET] = mask;
+}
+
+uint32_t serial_rx_depth(serial_dev_t *dev)
+{
+	return dev->rx_depth;
+}
+
+uint32_t serial_tx_depth(serial_dev_t *dev)
+{
+	return dev->tx_depth;
+}
+
+// FIFO fill levels; the status watermarks saturate at 31 entries, so
+// deeper FIFOs read the exact counts from the level register
+uint32_t serial_rx_level(serial_dev_t *dev, uint32_t status)
+{
+	if (dev->rx_depth > WATERMARK_MASK)
+		return LEVEL_RX(dev->base[LEVEL_REG_OFFSET]);
+	return RX_WATERMARK(status);
+}
+
+uint32_t serial_tx_level(serial_dev_t *dev, uint32_t status)
+{
+	if (dev->tx_depth > WATERMARK_MASK)
+		return LEVEL_TX(dev->base[LEVEL_REG_OFFSET]);
+	return TX_WATERMARK(status);
+}
+
+// Each pass writes exactly the free slots reported by one status read, and
+// passes repeat while the transmitter keeps making room
+size_t serial_write_buf(serial_dev_t *dev, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	size_t done = 0;
+	uint32_t room, word;
+
+	while (done < len) {
+		room = dev->tx_depth - serial_tx_level(dev, serial_status(dev));
+		if (room == 0)
+			break;
+		while (room >= 4 && len - done >= 4) {
+			memcpy(&word, p + done, 4);
+			dev->base[PACKED_REG_OFFSET] = word;
+			room -= 4;
+			done += 4;
+		}
+		while (room > 0 && done < len) {
+			dev->base[DATA_REG_OFFSET] = p[done];
+			room--;
+			done++;
+		}
+	}
+	return done;
+}
+
+// Each pass reads exactly the entries reported by one status read
+size_t serial_read_buf(serial_dev_t *dev, void *buf, size_t len)
+{
+	uint8_t *p = buf;
+	size_t done = 0;
+	uint32_t avail, word;
+
+	while (done < len) {
+		avail = serial_rx_level(dev, serial_status(dev));
+		if (avail == 0)
+			break;
+		while (avail >= 4 && len - done >= 4) {
+			word = dev->base[PACKED_REG_OFFSET];
+			memcpy(p + done, &word, 4);
+			avail -= 4;
+			done += 4;
+		}
+		while (avail > 0 && done < len) {
+			p[done] = dev->base[DATA_REG_OFFSET];
+			avail--;
+			done++;
+		}
+	}
+	return done;
+}
+
+int serial_uio_fd(serial_dev_t *dev)
+{
+	return dev->uio_fd;
+}
+
+int serial_irq_enable(serial_dev_t *dev)
+{
+	uint32_t on = 1;
+
+	if (dev->uio_fd < 0) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	return write(dev->uio_fd, &on, sizeof(on)) == sizeof(on) ? 0 : -1;
+}
+
+// The UIO read returns the running interrupt count
+int serial_irq_wait(serial_dev_t *dev, int timeout_ms, uint32_t *count)
+{
+	struct pollfd pfd = { .fd = dev->uio_fd, .events = POLLIN };
+	uint32_t irqs;
+	int ret;
+
+	if (dev->uio_fd < 0) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	do {
+		ret = poll(&pfd, 1, timeout_ms);
+	} while (ret < 0 && errno == EINTR);
+	if (ret <= 0)
+		return ret;
+
+	if (read(dev->uio_fd, &irqs, sizeof(irqs)) != sizeof(irqs))
+		return -1;
+	if (count)
+		*count = irqs;
+	return 1;
+}
+
+uint32_t serial_set_baud(serial_dev_t *dev, uint32_t baud)
+{
+	uint32_t brd, osr;
+	uint32_t actual = serial_baud_divisor(CLK_FREQ, baud, &brd, &osr);
+
+	if (actual == 0)
+		return 0;
+	dev->base[BRD_REG_OFFSET] = brd;
+	serial_update_reg(dev, CONTROL_REG_OFFSET, OSR_MASK, osr << OSR_OFFSET);
+	return actual;
+}
+
+uint32_t serial_get_baud(serial_dev_t *dev)
+{
+	uint32_t osr = (dev->base[CONTROL_REG_OFFSET] & OSR_MASK) >> OSR_OFFSET;
+
+	return serial_baud_rate(CLK_FREQ, dev->base[BRD_REG_OFFSET], osr);
+}
+
+uint32_t serial_get_brd(serial_dev_t *dev)
+{
+	return dev->base[BRD_REG_OFFSET];
+}
+
+void serial_enable(serial_dev_t *dev, bool on)
+{
+	serial_update_reg(dev, CONTROL_REG_OFFSET, ENABLE_MASK, on ? ENABLE_MASK : 0);
+}
+
+void serial_set_test(serial_dev_t *dev, bool on)
+{
+	serial_update_reg(dev, CONTROL_REG_OFFSET, TEST_MASK, on ? TEST_MASK : 0);
+}
+
+void serial_set_loopback(serial_dev_t *dev, bool on)
+{
+	serial_update_reg(dev, CONTROL_REG_OFFSET, LOOPBACK_MASK, on ? LOOPBACK_MASK : 0);
+}
+
+void serial_set_flow(serial_dev_t *dev, bool on, uint16_t rts_level)
+{
+	dev->base[FLOW_REG_OFFSET] = rts_level & FLOW_RTS_MASK;
+	serial_update_reg(dev, CONTROL_REG_OFFSET, RTS_MASK | AUTO_FLOW_MASK,
+	                  on ? RTS_MASK | AUTO_FLOW_MASK : 0);
+}
+
+// 5 to 8 data bits
+void serial_set_data_length(serial_dev_t *dev, uint8_t bits)
+{
+	serial_update_reg(dev, CONTROL_REG_OFFSET, DATA_LENGTH_MASK, bits - 5);
+}
+
+// 0 = none, 1 = even, 2 = odd
+void serial_set_parity(serial_dev_t *dev, uint8_t mode)
+{
+	serial_update_reg(dev, CONTROL_REG_OFFSET, PARITY_MODE_MASK, mode << 2);
+}
+
+// 1 or 2 stop bits
+void serial_set_stop_bits(serial_dev_t *dev, uint8_t bits)
+{
+	serial_update_reg(dev, CONTROL_REG_OFFSET, STOP_BITS_MASK, bits == 2 ? STOP_BITS_MASK : 0);
+}
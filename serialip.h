@@ -0,0 +1,85 @@
+// Serial IP User-Space Library
+// Olajumoke Aboderin
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Xilinx XUP Blackboard
+
+// Register access layer for the serial IP through /dev/mem or a UIO device.
+// Each handle owns one mapping and caches the FIFO depths, so a long-running
+// program maps an instance once and several instances can be driven from one
+// process. UIO handles can also sleep until the IP raises its interrupt.
+//
+// Build:
+//   gcc -O2 -c serialip.c && ar rcs libserialip.a serialip.o
+//   gcc -O2 -fPIC -shared serialip.c -o libserialip.so
+//   gcc -O2 serial_ip.c -L. -lserialip -o serial
+
+#ifndef SERIALIP_H_
+#define SERIALIP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "serial_regs.h"
+
+typedef struct serial_dev serial_dev_t;
+
+// Map the IP (or one channel of it) at a physical address; the address
+// need not be page-aligned. NULL on failure (errno is set)
+serial_dev_t *serial_open(off_t phys_base);
+// Map the IP through a UIO device node (e.g. /dev/uio0) bound by
+// uio_pdrv_genirq; see serial_uio.dtsi
+serial_dev_t *serial_open_uio(const char *path);
+void serial_close(serial_dev_t *dev);
+
+// Raw register access (reg is a word offset, e.g. STATUS_REG_OFFSET)
+uint32_t serial_read_reg(serial_dev_t *dev, unsigned int reg);
+void serial_write_reg(serial_dev_t *dev, unsigned int reg, uint32_t value);
+void serial_update_reg(serial_dev_t *dev, unsigned int reg, uint32_t mask, uint32_t value);
+
+// Status and FIFO levels
+uint32_t serial_status(serial_dev_t *dev);
+void serial_clear_status(serial_dev_t *dev, uint32_t mask);
+uint32_t serial_rx_depth(serial_dev_t *dev);
+uint32_t serial_tx_depth(serial_dev_t *dev);
+uint32_t serial_rx_level(serial_dev_t *dev, uint32_t status);
+uint32_t serial_tx_level(serial_dev_t *dev, uint32_t status);
+
+// Bulk transfers, batched on the FIFO levels with packed 4-byte accesses
+// Neither call waits: they move bytes until the TX FIFO is full or the RX
+// FIFO is empty and return the number of bytes transferred
+size_t serial_write_buf(serial_dev_t *dev, const void *buf, size_t len);
+size_t serial_read_buf(serial_dev_t *dev, void *buf, size_t len);
+
+// Interrupt wait (UIO handles only)
+// serial_irq_enable() unmasks the interrupt line, which uio_pdrv_genirq masks
+// each time it fires; serial_irq_wait() sleeps until the next interrupt or
+// timeout_ms (-1 = forever) and returns 1 on an interrupt, 0 on timeout and
+// -1 on error. serial_uio_fd() is the descriptor to add to a poll/epoll set
+int serial_uio_fd(serial_dev_t *dev);
+int serial_irq_enable(serial_dev_t *dev);
+int serial_irq_wait(serial_dev_t *dev, int timeout_ms, uint32_t *count);
+
+// Line configuration
+// serial_set_baud() picks the oversampling ratio and divisor closest to
+// baud (see serial_baud.h) and returns the rate achieved, or 0 (leaving
+// the line unchanged) when baud is out of range
+uint32_t serial_set_baud(serial_dev_t *dev, uint32_t baud);
+uint32_t serial_get_baud(serial_dev_t *dev);
+uint32_t serial_get_brd(serial_dev_t *dev);
+void serial_enable(serial_dev_t *dev, bool on);
+void serial_set_test(serial_dev_t *dev, bool on);
+// Internal loopback: TX feeds RX inside the IP and the tx_out pin idles
+void serial_set_loopback(serial_dev_t *dev, bool on);
+// RTS/CTS flow control: RTS asserted, dropping while the RX FIFO holds at
+// least rts_level entries (0 = full), and TX pausing while CTS is deasserted
+void serial_set_flow(serial_dev_t *dev, bool on, uint16_t rts_level);
+void serial_set_data_length(serial_dev_t *dev, uint8_t bits);
+void serial_set_parity(serial_dev_t *dev, uint8_t mode);
+void serial_set_stop_bits(serial_dev_t *dev, uint8_t bits);
+
+#endif